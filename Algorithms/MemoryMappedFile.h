@@ -0,0 +1,331 @@
+#pragma once
+#include <sstream>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    //The whole file is mapped into the memory.
+    //Several processes, mapping the same file, share the page cache.
+    class MemoryMappedFile final
+    {
+    public:
+
+      enum class Mode
+      {
+        ReadOnly,
+        //The file is created when missing.
+        ReadWrite,
+      };
+
+      //In the ReadWrite mode, a non-zero "size" sets the file size;
+      // the new bytes are zeros.
+      explicit MemoryMappedFile(const std::string& path,
+        const Mode mode = Mode::ReadOnly,
+        const size_t size = 0)
+        : _Data(nullptr), _Size(0), _Mode(mode)
+#ifdef _WIN32
+        , _File(INVALID_HANDLE_VALUE), _Mapping(nullptr)
+#else
+        , _File(-1)
+#endif
+      {
+        try
+        {
+          Open(path, size);
+        }
+        catch (...)
+        {
+          Close();
+          throw;
+        }
+      }
+
+      ~MemoryMappedFile()
+      {
+        Close();
+      }
+
+      MemoryMappedFile(const MemoryMappedFile&) = delete;
+      MemoryMappedFile& operator = (const MemoryMappedFile&) = delete;
+
+      MemoryMappedFile(MemoryMappedFile&& other)
+        : _Data(other._Data), _Size(other._Size), _Mode(other._Mode), _File(other._File)
+#ifdef _WIN32
+        , _Mapping(other._Mapping)
+#endif
+      {
+        other.Release();
+      }
+
+      MemoryMappedFile& operator = (MemoryMappedFile&& other)
+      {
+        if (this != &other)
+        {
+          Close();
+
+          _Data = other._Data;
+          _Size = other._Size;
+          _Mode = other._Mode;
+          _File = other._File;
+#ifdef _WIN32
+          _Mapping = other._Mapping;
+#endif
+          other.Release();
+        }
+
+        return *this;
+      }
+
+      inline const char* data() const
+      {
+        return _Data;
+      }
+
+      inline char* data()
+      {
+        return _Data;
+      }
+
+      inline size_t size() const
+      {
+        return _Size;
+      }
+
+      //Write the modified pages in [offset, offset + length) to the disk,
+      // and wait till done.
+      //The range is extended to the page boundaries.
+      void Flush(size_t offset = 0, size_t length = static_cast<size_t>(-1))
+      {
+        if (Mode::ReadWrite != _Mode || _Size <= offset)
+        {
+          return;
+        }
+
+        if (_Size - offset < length)
+        {
+          length = _Size - offset;
+        }
+
+        const auto page = PageSize();
+        const auto begin = offset - offset % page;
+        length += offset - begin;
+
+#ifdef _WIN32
+        if (!FlushViewOfFile(_Data + begin, length) || !FlushFileBuffers(_File))
+        {
+          ThrowLastError("flush", "");
+        }
+#else
+        if (0 != msync(_Data + begin, length, MS_SYNC))
+        {
+          ThrowLastError("flush", "");
+        }
+#endif
+      }
+
+    private:
+
+      char* _Data;
+      size_t _Size;
+      Mode _Mode;
+
+#ifdef _WIN32
+      HANDLE _File;
+      HANDLE _Mapping;
+
+      static size_t PageSize()
+      {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<size_t>(info.dwAllocationGranularity);
+      }
+
+      static void ThrowLastError(const char* action, const std::string& path)
+      {
+        std::ostringstream ss;
+        ss << "Cannot " << action << " the memory mapped file '" << path
+          << "', error " << GetLastError() << ".";
+        StreamUtilities::ThrowException(ss);
+      }
+
+      void Open(const std::string& path, const size_t size)
+      {
+        const auto isWrite = Mode::ReadWrite == _Mode;
+
+        _File = CreateFileA(path.c_str(),
+          isWrite ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+          FILE_SHARE_READ | (isWrite ? 0 : FILE_SHARE_WRITE),
+          nullptr,
+          isWrite ? OPEN_ALWAYS : OPEN_EXISTING,
+          FILE_ATTRIBUTE_NORMAL,
+          nullptr);
+        if (INVALID_HANDLE_VALUE == _File)
+        {
+          ThrowLastError("open", path);
+        }
+
+        LARGE_INTEGER fileSize;
+        if (isWrite && 0 != size)
+        {
+          fileSize.QuadPart = static_cast<LONGLONG>(size);
+          if (!SetFilePointerEx(_File, fileSize, nullptr, FILE_BEGIN)
+            || !SetEndOfFile(_File))
+          {
+            ThrowLastError("resize", path);
+          }
+        }
+
+        if (!GetFileSizeEx(_File, &fileSize))
+        {
+          ThrowLastError("get the size of", path);
+        }
+
+        _Size = static_cast<size_t>(fileSize.QuadPart);
+        if (0 == _Size)
+        {
+          return;
+        }
+
+        _Mapping = CreateFileMappingA(_File, nullptr,
+          isWrite ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (nullptr == _Mapping)
+        {
+          ThrowLastError("map", path);
+        }
+
+        _Data = static_cast<char*>(MapViewOfFile(_Mapping,
+          isWrite ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+        if (nullptr == _Data)
+        {
+          ThrowLastError("view", path);
+        }
+      }
+
+      void Close()
+      {
+        if (nullptr != _Data)
+        {
+          UnmapViewOfFile(_Data);
+        }
+
+        if (nullptr != _Mapping)
+        {
+          CloseHandle(_Mapping);
+        }
+
+        if (INVALID_HANDLE_VALUE != _File)
+        {
+          CloseHandle(_File);
+        }
+
+        Release();
+      }
+
+      void Release()
+      {
+        _Data = nullptr;
+        _Size = 0;
+        _File = INVALID_HANDLE_VALUE;
+        _Mapping = nullptr;
+      }
+#else
+      int _File;
+
+      static size_t PageSize()
+      {
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      }
+
+      static void ThrowLastError(const char* action, const std::string& path)
+      {
+        const auto error = errno;
+
+        std::ostringstream ss;
+        ss << "Cannot " << action << " the memory mapped file '" << path
+          << "', error " << error << ": " << std::strerror(error) << ".";
+        StreamUtilities::ThrowException(ss);
+      }
+
+      void Open(const std::string& path, const size_t size)
+      {
+        const auto isWrite = Mode::ReadWrite == _Mode;
+
+        _File = open(path.c_str(), isWrite ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (_File < 0)
+        {
+          ThrowLastError("open", path);
+        }
+
+        if (isWrite && 0 != size
+          && 0 != ftruncate(_File, static_cast<off_t>(size)))
+        {
+          ThrowLastError("resize", path);
+        }
+
+        struct stat status;
+        if (0 != fstat(_File, &status))
+        {
+          ThrowLastError("get the size of", path);
+        }
+
+        _Size = static_cast<size_t>(status.st_size);
+        if (0 == _Size)
+        {
+          return;
+        }
+
+        const auto data = mmap(nullptr, _Size,
+          isWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+          MAP_SHARED, _File, 0);
+        if (MAP_FAILED == data)
+        {
+          ThrowLastError("map", path);
+        }
+
+        _Data = static_cast<char*>(data);
+      }
+
+      void Close()
+      {
+        if (nullptr != _Data)
+        {
+          munmap(_Data, _Size);
+        }
+
+        if (0 <= _File)
+        {
+          close(_File);
+        }
+
+        Release();
+      }
+
+      void Release()
+      {
+        _Data = nullptr;
+        _Size = 0;
+        _File = -1;
+      }
+#endif
+    };
+  }
+}
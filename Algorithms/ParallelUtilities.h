@@ -0,0 +1,265 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace ParallelUtilities
+    {
+      //Return the "threadCount", or the number of hardware threads when zero.
+      inline size_t ThreadCount(const size_t threadCount = 0)
+      {
+        if (0 != threadCount)
+        {
+          return threadCount;
+        }
+
+        const auto hardware = static_cast<size_t>(std::thread::hardware_concurrency());
+        const auto result = 0 == hardware ? size_t(1) : hardware;
+        return result;
+      }
+
+      //Keeps its threads between the ParallelFor calls,
+      // so that many short calls do not pay for starting and joining the threads.
+      //The calling thread takes part as the thread 0.
+      //
+      //A pool runs one ParallelFor at a time; the concurrent calls wait.
+      //An action must not call the ParallelFor of its own pool.
+      class ThreadPool final
+      {
+        std::vector<std::thread> _Workers;
+
+        std::mutex _Mutex;
+        std::condition_variable _JobReady;
+        std::condition_variable _JobDone;
+
+        //Called with the thread index, it must not throw.
+        const std::function<void(size_t)>* _Job = nullptr;
+        //Incremented for each job, so that a worker sees a new one.
+        size_t _JobNumber = 0;
+        //The workers, still running the job.
+        size_t _BusyCount = 0;
+        bool _IsStopping = false;
+
+        //Lets one job run at a time.
+        std::mutex _RunMutex;
+
+      public:
+
+        //The "threadCount", including the calling thread;
+        // if zero, then the number of hardware threads.
+        explicit ThreadPool(const size_t threadCount = 0);
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator =(const ThreadPool&) = delete;
+
+        ~ThreadPool();
+
+        //The number of threads, including the calling one.
+        size_t size() const noexcept
+        {
+          return _Workers.size() + 1;
+        }
+
+        //Split [0, count) into blocks of the "blockSize" items,
+        // and call the "action(threadIndex, begin, end)" for each block.
+        //A thread, having finished a block, claims the next free one,
+        // so that a slow block does not stall the others.
+        //
+        //The "threadIndex" is in [0, size()) and can select per-thread buffers.
+        //The first exception, if any, is rethrown after all threads have stopped.
+        template <typename TAction>
+        void ParallelFor(const size_t count,
+          const size_t blockSize,
+          TAction action);
+
+      private:
+
+        void Work(const size_t threadIndex);
+
+        //Call the "job" on every thread, and wait for all of them.
+        void Run(const std::function<void(size_t)>& job);
+
+        void Stop();
+      };
+
+      //The same as the ThreadPool::ParallelFor,
+      // but the threads are started for this call only.
+      //A caller, making many calls, should keep a ThreadPool instead.
+      template <typename TAction>
+      void ParallelFor(const size_t count,
+        const size_t threadCount,
+        const size_t blockSize,
+        TAction action)
+      {
+        const auto block = std::max(blockSize, size_t(1));
+        const auto blocks = std::max((count + block - 1) / block, size_t(1));
+
+        ThreadPool pool(std::min(ThreadCount(threadCount), blocks));
+        pool.ParallelFor(count, blockSize, action);
+      }
+
+      inline ThreadPool::ThreadPool(const size_t threadCount)
+      {
+        const auto workerCount = ThreadCount(threadCount) - 1;
+        _Workers.reserve(workerCount);
+
+        try
+        {
+          for (size_t threadIndex = 1; threadIndex <= workerCount; ++threadIndex)
+          {
+            _Workers.emplace_back(&ThreadPool::Work, this, threadIndex);
+          }
+        }
+        catch (...)
+        {
+          Stop();
+          throw;
+        }
+      }
+
+      inline ThreadPool::~ThreadPool()
+      {
+        Stop();
+      }
+
+      template <typename TAction>
+      void ThreadPool::ParallelFor(const size_t count,
+        const size_t blockSize,
+        TAction action)
+      {
+        const auto block = std::max(blockSize, size_t(1));
+        const auto blocks = (count + block - 1) / block;
+
+        std::atomic<size_t> nextBlock(0);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        const std::function<void(size_t)> run = [&](const size_t threadIndex)
+        {
+          try
+          {
+            for (;;)
+            {
+              const auto current = nextBlock.fetch_add(1, std::memory_order_relaxed);
+              if (blocks <= current)
+              {
+                break;
+              }
+
+              const auto begin = current * block;
+              const auto end = std::min(begin + block, count);
+              action(threadIndex, begin, end);
+            }
+          }
+          catch (...)
+          {
+            //Make the other threads stop.
+            nextBlock.store(blocks, std::memory_order_relaxed);
+
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+            {
+              error = std::current_exception();
+            }
+          }
+        };
+
+        if (blocks <= 1 || _Workers.empty())
+        {
+          run(0);
+        }
+        else
+        {
+          Run(run);
+        }
+
+        if (error)
+        {
+          std::rethrow_exception(error);
+        }
+      }
+
+      inline void ThreadPool::Work(const size_t threadIndex)
+      {
+        size_t jobNumber = 0;
+        for (;;)
+        {
+          const std::function<void(size_t)>* job;
+          {
+            std::unique_lock<std::mutex> lock(_Mutex);
+            _JobReady.wait(lock, [&](void) -> bool
+            {
+              return _IsStopping || jobNumber != _JobNumber;
+            });
+
+            if (_IsStopping)
+            {
+              return;
+            }
+
+            jobNumber = _JobNumber;
+            job = _Job;
+          }
+
+          (*job)(threadIndex);
+
+          bool isLast;
+          {
+            std::lock_guard<std::mutex> lock(_Mutex);
+            isLast = 0 == --_BusyCount;
+          }
+
+          if (isLast)
+          {
+            _JobDone.notify_one();
+          }
+        }
+      }
+
+      inline void ThreadPool::Run(const std::function<void(size_t)>& job)
+      {
+        std::lock_guard<std::mutex> runLock(_RunMutex);
+        {
+          std::lock_guard<std::mutex> lock(_Mutex);
+          _Job = &job;
+          ++_JobNumber;
+          _BusyCount = _Workers.size();
+        }
+
+        _JobReady.notify_all();
+        job(0);
+
+        std::unique_lock<std::mutex> lock(_Mutex);
+        _JobDone.wait(lock, [&](void) -> bool
+        {
+          return 0 == _BusyCount;
+        });
+
+        _Job = nullptr;
+      }
+
+      inline void ThreadPool::Stop()
+      {
+        {
+          std::lock_guard<std::mutex> lock(_Mutex);
+          _IsStopping = true;
+        }
+
+        _JobReady.notify_all();
+        for (auto& worker : _Workers)
+        {
+          worker.join();
+        }
+      }
+    }
+  }
+}
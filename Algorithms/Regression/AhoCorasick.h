@@ -0,0 +1,188 @@
+#pragma once
+#include <queue>
+#include <vector>
+
+#include "DoubleArrayTrie.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //Aho-Corasick automaton: find all the dictionary words in a text in one pass.
+      //The goto function is a DoubleArrayTrie,
+      // extended with the failure and the dictionary suffix links.
+      //
+      //The running time is O(|text| + number of matches).
+      template <typename TSize = size_t>
+      class AhoCorasick final
+      {
+      public:
+
+        using TTrie = DoubleArrayTrie<TSize>;
+        using TIndex = typename TTrie::TIndex;
+
+        template <typename TWords>
+        explicit AhoCorasick(const TWords& words);
+
+        inline size_t size() const
+        {
+          return _Trie.size();
+        }
+
+        inline bool empty() const
+        {
+          return _Trie.empty();
+        }
+
+        inline TSize get_MaxLength() const
+        {
+          return _Trie.get_MaxLength();
+        }
+
+        inline const TTrie& get_Trie() const
+        {
+          return _Trie;
+        }
+
+        inline TIndex get_RootState() const
+        {
+          return TTrie::RootState;
+        }
+
+        //Consume the "letter", following the failure links when needed.
+        TIndex Next(TIndex state, const char letter) const;
+
+        //Call the "action(length, wordId)" for every word ending in the "state",
+        // the longest word first.
+        template <typename TAction>
+        void ForEachMatch(const TIndex state, TAction action) const;
+
+        //Call the "action(end, length, wordId)" for every word occurrence in [begin, end),
+        // where "end" is the offset past the last word letter.
+        //The ends do not decrease; for the same end, the longest word comes first.
+        template <typename TAction>
+        void Scan(const char* begin, const char* end, TAction action) const;
+
+      private:
+
+        TTrie _Trie;
+
+        //The longest proper suffix state.
+        std::vector<TIndex> _Failures;
+
+        //The longest proper suffix state being a word, or 0.
+        std::vector<TIndex> _Outputs;
+
+        std::vector<TSize> _Depths;
+
+        void Build();
+      };
+
+      template <typename TSize>
+      template <typename TWords>
+      AhoCorasick<TSize>::AhoCorasick(const TWords& words)
+        : _Trie(words)
+      {
+        Build();
+      }
+
+      template <typename TSize>
+      typename AhoCorasick<TSize>::TIndex
+        AhoCorasick<TSize>::Next(TIndex state, const char letter) const
+      {
+        for (;;)
+        {
+          const auto next = _Trie.Next(state, letter);
+          if (0 != next)
+          {
+            return next;
+          }
+
+          if (TTrie::RootState == state)
+          {
+            return state;
+          }
+
+          state = _Failures[state];
+        }
+      }
+
+      template <typename TSize>
+      template <typename TAction>
+      void AhoCorasick<TSize>::ForEachMatch(const TIndex state, TAction action) const
+      {
+        auto current = TTrie::NotFound == _Trie.WordId(state)
+          ? _Outputs[state]
+          : state;
+
+        while (0 != current)
+        {
+          action(_Depths[current], _Trie.WordId(current));
+          current = _Outputs[current];
+        }
+      }
+
+      template <typename TSize>
+      template <typename TAction>
+      void AhoCorasick<TSize>::Scan(
+        const char* begin, const char* end, TAction action) const
+      {
+        auto state = get_RootState();
+        for (auto current = begin; current != end;)
+        {
+          state = Next(state, *current);
+          ++current;
+
+          const auto offset = static_cast<TSize>(current - begin);
+          ForEachMatch(state,
+            [&](const TSize length, const size_t wordId)
+          {
+            action(offset, length, wordId);
+          });
+        }
+      }
+
+      template <typename TSize>
+      void AhoCorasick<TSize>::Build()
+      {
+        const auto stateCount = _Trie.get_StateCount();
+        _Failures.assign(stateCount, 0);
+        _Outputs.assign(stateCount, 0);
+        _Depths.assign(stateCount, 0);
+
+        const auto root = TTrie::RootState;
+        _Failures[root] = root;
+
+        //Breadth first, so that the shorter suffixes are ready.
+        std::queue<TIndex> states;
+        states.push(root);
+
+        while (!states.empty())
+        {
+          const auto state = states.front();
+          states.pop();
+
+          //Only the existing children: a missing transition is resolved by the Next
+          // through the failure links, so the work is O(states), not O(states * 256).
+          _Trie.ForEachChild(state, [&](const char letter, const TIndex child)
+          {
+            _Depths[child] = _Depths[state] + 1;
+
+            const auto failure = root == state
+              ? root
+              : Next(_Failures[state], letter);
+            _Failures[child] = failure;
+
+            _Outputs[child] = TTrie::NotFound == _Trie.WordId(failure)
+              ? _Outputs[failure]
+              : failure;
+
+            states.push(child);
+          });
+        }
+      }
+    }
+  }
+}
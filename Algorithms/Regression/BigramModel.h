@@ -0,0 +1,274 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "DoubleArrayTrie.h"
+#include "../ExceptionUtilities.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //A bigram language model over the words, compiled into a DoubleArrayTrie.
+      //The weights are log-probabilities: the larger, the better.
+      //The weight of a "word" after the "previous" one is:
+      // - the bigram weight when the pair is known,
+      // - else Backoff(previous) + Unigram(word).
+      //
+      //The bigrams are stored as a sparse matrix in the compressed row format:
+      // the second word ids of a row are sorted,
+      // so that a lookup is a binary search in a few adjacent cache lines.
+      //A bit filter of the pairs rejects most unknown pairs before the row is read.
+      template <typename TSize = size_t,
+        typename TWeight = double>
+      class BigramModel final
+      {
+      public:
+
+        using TIndex = typename DoubleArrayTrie<TSize>::TIndex;
+
+        struct Unigram final
+        {
+          std::string Word;
+          TWeight Weight;
+          TWeight Backoff;
+        };
+
+        //The empty "First" stands for the text beginning.
+        struct Bigram final
+        {
+          std::string First;
+          std::string Second;
+          TWeight Weight;
+        };
+
+        BigramModel(const std::vector<Unigram>& unigrams,
+          const std::vector<Bigram>& bigrams,
+          //The weight of a letter, taken as an unknown word.
+          //It should be less than any unigram weight.
+          const TWeight unknownLetterWeight);
+
+        inline const DoubleArrayTrie<TSize>& get_Words() const
+        {
+          return _Words;
+        }
+
+        inline size_t size() const
+        {
+          return _Words.size();
+        }
+
+        //The previous word id at the text beginning.
+        inline TIndex get_BeginId() const
+        {
+          return static_cast<TIndex>(size());
+        }
+
+        //The word id of an unknown letter.
+        //It has no bigrams, and its backoff is zero.
+        inline TIndex get_UnknownId() const
+        {
+          return static_cast<TIndex>(size() + 1);
+        }
+
+        //Find the bigram weight of the "wordId" after the "previousId".
+        //Return false when the pair is unknown.
+        inline bool FindBigram(const TIndex previousId, const TIndex wordId,
+          TWeight& weight) const
+        {
+          //Most pairs are unknown: they are rejected without reading the row.
+          const auto bit = FilterBit(previousId, wordId);
+          if (0 == (_Filter[bit >> 6] & (std::uint64_t(1) << (bit & 63))))
+          {
+            return false;
+          }
+
+          const auto rowBegin = _Seconds.begin() + _Rows[previousId].Begin;
+          const auto rowEnd = _Seconds.begin() + _Rows[previousId + 1].Begin;
+
+          const auto found = std::lower_bound(rowBegin, rowEnd, wordId);
+          if (rowEnd == found || wordId != *found)
+          {
+            return false;
+          }
+
+          weight = _Weights[found - _Seconds.begin()];
+          return true;
+        }
+
+        inline TWeight get_Backoff(const TIndex previousId) const
+        {
+          return _Rows[previousId].Backoff;
+        }
+
+        inline TWeight get_Unigram(const TIndex wordId) const
+        {
+          return _Rows[wordId].Unigram;
+        }
+
+        inline TWeight get_UnknownLetterWeight() const
+        {
+          return _UnknownLetterWeight;
+        }
+
+      private:
+
+        DoubleArrayTrie<TSize> _Words;
+        TWeight _UnknownLetterWeight;
+
+        //The data of a word, kept together to be read at once.
+        struct Row final
+        {
+          TWeight Unigram;
+          TWeight Backoff;
+          size_t Begin;
+        };
+
+        //Indexed by the previous word id, including the begin and unknown ids,
+        // and one more for the end of the last row.
+        //The bigrams of the "previousId" are in
+        // [_Rows[previousId].Begin, _Rows[previousId + 1].Begin).
+        std::vector<Row> _Rows;
+        std::vector<TIndex> _Seconds;
+        std::vector<TWeight> _Weights;
+
+        //A bit per pair hash, set for every bigram; about 8 bits per bigram,
+        // so that an unknown pair passes with the chance of about 1/8.
+        std::vector<std::uint64_t> _Filter;
+        int _FilterShift;
+
+        inline size_t FilterBit(const TIndex previousId, const TIndex wordId) const
+        {
+          const auto key = (static_cast<std::uint64_t>(previousId) << 32) ^ wordId;
+          const auto result = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> _FilterShift);
+          return result;
+        }
+
+        static std::vector<std::string> WordsOf(const std::vector<Unigram>& unigrams);
+
+        TIndex FindId(const std::string& word, const char* name) const;
+      };
+
+      template <typename TSize, typename TWeight>
+      BigramModel<TSize, TWeight>::BigramModel(
+        const std::vector<Unigram>& unigrams,
+        const std::vector<Bigram>& bigrams,
+        const TWeight unknownLetterWeight)
+        : _Words(WordsOf(unigrams)),
+        _UnknownLetterWeight(unknownLetterWeight)
+      {
+        if (_Words.size() != unigrams.size())
+        {
+          std::ostringstream ss;
+          ss << "The unigrams must be unique, but there are "
+            << (unigrams.size() - _Words.size()) << " duplicates.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        const auto wordCount = _Words.size();
+        _Rows.assign(wordCount + 3, Row{ TWeight(), TWeight(), 0 });
+
+        for (const auto& unigram : unigrams)
+        {
+          const auto wordId = FindId(unigram.Word, "unigram");
+          _Rows[wordId].Unigram = unigram.Weight;
+          _Rows[wordId].Backoff = unigram.Backoff;
+        }
+
+        std::vector<std::tuple<TIndex, TIndex, TWeight>> pairs;
+        pairs.reserve(bigrams.size());
+
+        for (const auto& bigram : bigrams)
+        {
+          const auto firstId = bigram.First.empty()
+            ? get_BeginId()
+            : FindId(bigram.First, "first");
+
+          pairs.emplace_back(firstId, FindId(bigram.Second, "second"), bigram.Weight);
+        }
+
+        std::sort(pairs.begin(), pairs.end());
+
+        _Seconds.resize(pairs.size());
+        _Weights.resize(pairs.size());
+
+        for (size_t index = 0; index < pairs.size(); ++index)
+        {
+          const auto firstId = std::get<0>(pairs[index]);
+          const auto secondId = std::get<1>(pairs[index]);
+          if (0 < index
+            && firstId == std::get<0>(pairs[index - 1])
+            && secondId == std::get<1>(pairs[index - 1]))
+          {
+            std::ostringstream ss;
+            ss << "The bigram (" << firstId << ", " << secondId << ") is duplicated.";
+            StreamUtilities::ThrowException(ss);
+          }
+
+          ++_Rows[firstId + 1].Begin;
+          _Seconds[index] = secondId;
+          _Weights[index] = std::get<2>(pairs[index]);
+        }
+
+        for (size_t index = 1; index < _Rows.size(); ++index)
+        {
+          _Rows[index].Begin += _Rows[index - 1].Begin;
+        }
+
+        //At least 64 bits, a power of 2.
+        _FilterShift = 64 - 6;
+        while ((size_t(1) << (64 - _FilterShift)) < pairs.size() * 8)
+        {
+          --_FilterShift;
+        }
+
+        _Filter.assign((size_t(1) << (64 - _FilterShift)) / 64, 0);
+        for (const auto& pair : pairs)
+        {
+          const auto bit = FilterBit(std::get<0>(pair), std::get<1>(pair));
+          _Filter[bit >> 6] |= std::uint64_t(1) << (bit & 63);
+        }
+      }
+
+      template <typename TSize, typename TWeight>
+      std::vector<std::string> BigramModel<TSize, TWeight>::WordsOf(
+        const std::vector<Unigram>& unigrams)
+      {
+        ThrowIfEmpty(unigrams, "unigrams");
+
+        std::vector<std::string> result;
+        result.reserve(unigrams.size());
+
+        for (const auto& unigram : unigrams)
+        {
+          result.push_back(unigram.Word);
+        }
+
+        return result;
+      }
+
+      template <typename TSize, typename TWeight>
+      typename BigramModel<TSize, TWeight>::TIndex
+        BigramModel<TSize, TWeight>::FindId(
+          const std::string& word, const char* name) const
+      {
+        const auto wordId = _Words.find(word.c_str(), word.size());
+        if (DoubleArrayTrie<TSize>::NotFound == wordId)
+        {
+          std::ostringstream ss;
+          ss << "The " << name << " word '" << word << "' must be a unigram.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        return static_cast<TIndex>(wordId);
+      }
+    }
+  }
+}
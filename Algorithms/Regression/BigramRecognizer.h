@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BigramModel.h"
+#include "WordPosition.h"
+#include "../ExceptionUtilities.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //Like the WordRecognizer, but a segmentation is scored by a BigramModel,
+      // so that the choice of a word depends on the previous one.
+      //
+      //The Viterbi state is (position, previous word id).
+      //Only the "beamWidth" best states of a position are extended,
+      // which bounds the cost, but the result may be not the best one.
+      template <typename TSize = size_t,
+        typename TWeight = double>
+      class BigramRecognizer final
+      {
+        BigramRecognizer() = delete;
+
+      public:
+
+        using WordPosition = WordPosition<TSize>;
+        using CostAndPositions = std::pair<TWeight, std::vector<WordPosition>>;
+        using Model = BigramModel<TSize, TWeight>;
+
+        static constexpr size_t DefaultBeamWidth = 8;
+
+        //Insert separators to maximize the total model weight.
+        //A letter, which is not a one-letter word, may also be taken as an unknown word.
+        //Return the total weight and words positions(offset and length).
+        //
+        //The words, starting at an offset, are found once by walking the trie,
+        // then each of them is looked up in the bigram row of each surviving state;
+        // a long row of a frequent word is not scanned.
+        //A word without a bigram takes the backoff from the best such state.
+        //The running time is O(|text| * beamWidth * |longest word| * log(bigrams per word)).
+        //
+        //When there are no bigrams, the beam width of 1 gives the best unigram segmentation.
+        static CostAndPositions Recognize(
+          const std::string& text,
+          const Model& model,
+          const size_t beamWidth = DefaultBeamWidth);
+
+      private:
+
+        using TIndex = typename Model::TIndex;
+
+        static constexpr size_t NoNode = static_cast<size_t>(-1);
+
+        //A word ending at a position, not yet pruned.
+        struct Hypothesis final
+        {
+          TWeight Weight;
+          TIndex WordId;
+          TSize Length;
+          //The node of the previous word.
+          size_t Previous;
+        };
+
+        //A word, having survived the pruning; kept for the backtrace.
+        struct Node final
+        {
+          TSize Offset;
+          TSize Length;
+          size_t Previous;
+        };
+
+        struct State final
+        {
+          TWeight Weight;
+          TIndex WordId;
+          size_t Node;
+        };
+
+        //Two hypotheses with the same last word are recombined:
+        // they have the same future, so only the better one is kept.
+        static void Insert(std::vector<Hypothesis>& hypotheses,
+          const Hypothesis& hypothesis);
+
+        //Keep the "beamWidth" best "hypotheses" ending at the "position",
+        // and make them the current "states".
+        static void Prune(std::vector<Hypothesis>& hypotheses,
+          const size_t position,
+          const size_t beamWidth,
+          std::vector<Node>& nodes,
+          std::vector<State>& states);
+      };
+
+      template <typename TSize, typename TWeight>
+      typename BigramRecognizer<TSize, TWeight>::CostAndPositions
+        BigramRecognizer<TSize, TWeight>::Recognize(
+          const std::string& text,
+          const Model& model,
+          const size_t beamWidth)
+      {
+        ThrowIfEmpty(text, "text");
+        if (0 == beamWidth)
+        {
+          throw std::runtime_error("The beamWidth must be positive.");
+        }
+
+        const auto& words = model.get_Words();
+        const auto size = text.size();
+        const auto maxLength = std::max(static_cast<size_t>(words.get_MaxLength()), size_t(1));
+
+        //The hypotheses, ending at the "position", are in the "pending[position % ring]".
+        const auto ring = maxLength + 1;
+        std::vector<std::vector<Hypothesis>> pending(ring);
+
+        //Few words end at a position, e.g. 2.3 with the beam of 8 on an English-like text,
+        // so that reserving a node per beam slot would only waste the memory.
+        std::vector<Node> nodes;
+        nodes.reserve(size * std::min(beamWidth, size_t(3)));
+
+        std::vector<State> states{ { TWeight(), model.get_BeginId(), NoNode } };
+
+        //The length and id of the words starting at the current offset.
+        std::vector<std::pair<TSize, TIndex>> matches;
+
+        //The weight plus backoff of the states[i].
+        std::vector<TWeight> backoffWeights;
+
+        for (size_t begin = 0; begin < size; ++begin)
+        {
+          if (0 < begin)
+          {
+            Prune(pending[begin % ring], begin, beamWidth, nodes, states);
+          }
+
+          matches.clear();
+          words.ForEachPrefix(text.data() + begin,
+            text.data() + std::min(begin + maxLength, size),
+            [&](const TSize length, const size_t wordId)
+          {
+            matches.emplace_back(length, static_cast<TIndex>(wordId));
+          });
+
+          const auto isKnownLetter = !matches.empty() && 1 == matches.front().first;
+
+          //A word without a bigram follows the state of the best weight plus backoff;
+          // the ties are broken by the state index to be deterministic.
+          backoffWeights.clear();
+          size_t bestState = 0;
+          for (size_t index = 0; index < states.size(); ++index)
+          {
+            const auto& state = states[index];
+            backoffWeights.push_back(state.Weight + model.get_Backoff(state.WordId));
+            if (backoffWeights[bestState] < backoffWeights.back())
+            {
+              bestState = index;
+            }
+          }
+
+          //The unknown letter has no bigrams.
+          if (!isKnownLetter)
+          {
+            Insert(pending[(begin + 1) % ring],
+              { backoffWeights[bestState] + model.get_UnknownLetterWeight(),
+              model.get_UnknownId(), TSize(1), states[bestState].Node });
+          }
+
+          for (const auto& match : matches)
+          {
+            auto& hypotheses = pending[(begin + match.first) % ring];
+
+            //The backoff applies only when there is no bigram,
+            // so that it is taken from the best state, lacking one.
+            auto backoffState = NoNode;
+            for (size_t index = 0; index < states.size(); ++index)
+            {
+              const auto& state = states[index];
+
+              TWeight weight;
+              if (model.FindBigram(state.WordId, match.second, weight))
+              {
+                Insert(hypotheses, { state.Weight + weight, match.second, match.first, state.Node });
+              }
+              else if (NoNode == backoffState
+                || backoffWeights[backoffState] < backoffWeights[index])
+              {
+                backoffState = index;
+              }
+            }
+
+            if (NoNode != backoffState)
+            {
+              Insert(hypotheses, { backoffWeights[backoffState] + model.get_Unigram(match.second),
+                match.second, match.first, states[backoffState].Node });
+            }
+          }
+        }
+
+        Prune(pending[size % ring], size, 1, nodes, states);
+
+        CostAndPositions result;
+        result.first = states.front().Weight;
+
+        for (auto node = states.front().Node; NoNode != node; node = nodes[node].Previous)
+        {
+          result.second.push_back({ nodes[node].Offset, nodes[node].Length });
+        }
+
+        std::reverse(result.second.begin(), result.second.end());
+        return result;
+      }
+
+      template <typename TSize, typename TWeight>
+      void BigramRecognizer<TSize, TWeight>::Insert(
+        std::vector<Hypothesis>& hypotheses,
+        const Hypothesis& hypothesis)
+      {
+        for (auto& other : hypotheses)
+        {
+          if (hypothesis.WordId == other.WordId)
+          {
+            if (other.Weight < hypothesis.Weight)
+            {
+              other = hypothesis;
+            }
+
+            return;
+          }
+        }
+
+        hypotheses.push_back(hypothesis);
+      }
+
+      template <typename TSize, typename TWeight>
+      void BigramRecognizer<TSize, TWeight>::Prune(
+        std::vector<Hypothesis>& hypotheses,
+        const size_t position,
+        const size_t beamWidth,
+        std::vector<Node>& nodes,
+        std::vector<State>& states)
+      {
+#ifdef _DEBUG
+        if (hypotheses.empty())
+        {
+          std::ostringstream ss;
+          ss << "There are no hypotheses at the position " << position << ".";
+          StreamUtilities::ThrowException(ss);
+        }
+#endif
+        const auto count = std::min(beamWidth, hypotheses.size());
+        if (count < hypotheses.size())
+        {//The ties are broken by the word id to be deterministic.
+          const auto isBetter = [](const Hypothesis& a, const Hypothesis& b)
+          {
+            return b.Weight < a.Weight
+              || (!(a.Weight < b.Weight) && a.WordId < b.WordId);
+          };
+
+          std::nth_element(hypotheses.begin(), hypotheses.begin() + (count - 1),
+            hypotheses.end(), isBetter);
+        }
+
+        states.clear();
+        for (size_t index = 0; index < count; ++index)
+        {
+          const auto& hypothesis = hypotheses[index];
+          nodes.push_back({ static_cast<TSize>(position - hypothesis.Length),
+            hypothesis.Length, hypothesis.Previous });
+
+          states.push_back({ hypothesis.Weight, hypothesis.WordId, nodes.size() - 1 });
+        }
+
+        hypotheses.clear();
+      }
+    }
+  }
+}
@@ -0,0 +1,250 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //Holds the current version of a dictionary, which can be replaced
+      // while other threads keep recognizing texts with the previous one.
+      //
+      //A reader pins the current Snapshot without taking a lock,
+      // and the Snapshot stays valid until the Pin is destroyed.
+      //A writer builds the next Snapshot aside, then publishes it atomically.
+      //
+      //The reclamation is epoch based:
+      // - A reader, while pinning, writes the current epoch into a free reader slot.
+      // - A writer, replacing a snapshot, advances the epoch,
+      //   and retires the old snapshot together with the old epoch.
+      // - A retired snapshot is deleted once every busy slot has a later epoch,
+      //   as those readers have loaded the newer snapshot.
+      //
+      //Usage:
+      //  const auto pin = holder.Acquire();
+      //  WordRecognizer<...>::Recognize(text, pin->Words, pin->MaxLengthOfWord, workspace, result);
+      template <typename TDictionary,
+        typename TSize = size_t,
+        //The maximum number of simultaneous pins.
+        size_t SlotCount = 64>
+      class DictionaryHolder final
+      {
+      public:
+
+        struct Snapshot final
+        {
+          TDictionary Words;
+          TSize MaxLengthOfWord;
+        };
+
+        //Keeps a Snapshot alive; it must not outlive the holder.
+        class Pin final
+        {
+          friend class DictionaryHolder;
+
+          std::atomic<std::uint64_t>* _Slot;
+          const Snapshot* _Snapshot;
+
+          Pin(std::atomic<std::uint64_t>* slot, const Snapshot* snapshot)
+            : _Slot(slot), _Snapshot(snapshot)
+          {
+          }
+
+        public:
+
+          Pin(const Pin&) = delete;
+          Pin& operator =(const Pin&) = delete;
+
+          Pin(Pin&& other) noexcept
+            : _Slot(other._Slot), _Snapshot(other._Snapshot)
+          {
+            other._Slot = nullptr;
+          }
+
+          ~Pin()
+          {
+            if (nullptr != _Slot)
+            {
+              _Slot->store(IdleEpoch);
+            }
+          }
+
+          inline const Snapshot& operator *() const
+          {
+            return *_Snapshot;
+          }
+
+          inline const Snapshot* operator ->() const
+          {
+            return _Snapshot;
+          }
+        };
+
+        //The "maxLengthOfWord" is usually precomputed by the writer,
+        // e.g. WordRecognizer::WordMaxLength(words).
+        DictionaryHolder(TDictionary words, const TSize maxLengthOfWord);
+
+        DictionaryHolder(const DictionaryHolder&) = delete;
+        DictionaryHolder& operator =(const DictionaryHolder&) = delete;
+
+        //All the pins must have been destroyed.
+        ~DictionaryHolder();
+
+        //Lock free, unless all the SlotCount slots are busy:
+        // then it yields until a slot is released.
+        Pin Acquire() const;
+
+        //Make the "words" current. The readers, having pinned the previous snapshot,
+        // keep using it; it is deleted later by a Publish or Reclaim.
+        //The writers are serialized.
+        void Publish(TDictionary words, const TSize maxLengthOfWord);
+
+        //Delete the retired snapshots, which are no longer pinned.
+        //Return the number of the retired snapshots still pinned.
+        size_t Reclaim();
+
+      private:
+
+        static constexpr std::uint64_t IdleEpoch = 0;
+
+        //A slot per cache line, not to slow down the readers of the neighbor slots.
+        struct alignas(64) Slot final
+        {
+          std::atomic<std::uint64_t> Epoch;
+        };
+
+        mutable Slot _Slots[SlotCount];
+
+        std::atomic<std::uint64_t> _Epoch;
+        std::atomic<const Snapshot*> _Current;
+
+        std::mutex _WriterMutex;
+
+        //Each snapshot is with the epoch, when it stopped being current.
+        std::vector<std::pair<std::uint64_t, std::unique_ptr<const Snapshot>>> _Retired;
+
+        size_t ReclaimUnlocked();
+      };
+
+      template <typename TDictionary, typename TSize, size_t SlotCount>
+      DictionaryHolder<TDictionary, TSize, SlotCount>::DictionaryHolder(
+        TDictionary words, const TSize maxLengthOfWord)
+        : _Epoch(IdleEpoch + 1),
+        _Current(new Snapshot{ std::move(words), maxLengthOfWord })
+      {
+        static_assert(0 < SlotCount, "The SlotCount must be positive.");
+
+        for (auto& slot : _Slots)
+        {
+          slot.Epoch.store(IdleEpoch, std::memory_order_relaxed);
+        }
+      }
+
+      template <typename TDictionary, typename TSize, size_t SlotCount>
+      DictionaryHolder<TDictionary, TSize, SlotCount>::~DictionaryHolder()
+      {
+#ifndef NDEBUG
+        //Not a throw: a destructor is noexcept.
+        for (const auto& slot : _Slots)
+        {
+          assert(IdleEpoch == slot.Epoch.load() && "A dictionary snapshot is still pinned.");
+        }
+#endif
+        delete _Current.load();
+      }
+
+      template <typename TDictionary, typename TSize, size_t SlotCount>
+      typename DictionaryHolder<TDictionary, TSize, SlotCount>::Pin
+        DictionaryHolder<TDictionary, TSize, SlotCount>::Acquire() const
+      {
+        //Different threads start at different slots to avoid contention.
+        const auto start = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        for (;;)
+        {
+          for (size_t index = 0; index < SlotCount; ++index)
+          {
+            auto& epoch = _Slots[(start + index) % SlotCount].Epoch;
+
+            auto expected = IdleEpoch;
+            if (IdleEpoch == epoch.load(std::memory_order_relaxed)
+              && epoch.compare_exchange_strong(expected, _Epoch.load()))
+            {
+              //The slot is written before the snapshot is loaded,
+              // and both are sequentially consistent:
+              // a writer, not seeing the slot, has published before the load.
+              return Pin(&epoch, _Current.load());
+            }
+          }
+
+          std::this_thread::yield();
+        }
+      }
+
+      template <typename TDictionary, typename TSize, size_t SlotCount>
+      void DictionaryHolder<TDictionary, TSize, SlotCount>::Publish(
+        TDictionary words, const TSize maxLengthOfWord)
+      {
+        std::unique_ptr<const Snapshot> next(
+          new Snapshot{ std::move(words), maxLengthOfWord });
+
+        std::lock_guard<std::mutex> lock(_WriterMutex);
+        _Retired.reserve(_Retired.size() + 1);
+
+        std::unique_ptr<const Snapshot> previous(_Current.exchange(next.release()));
+        const auto epoch = _Epoch.fetch_add(1);
+        _Retired.emplace_back(epoch, std::move(previous));
+
+        ReclaimUnlocked();
+      }
+
+      template <typename TDictionary, typename TSize, size_t SlotCount>
+      size_t DictionaryHolder<TDictionary, TSize, SlotCount>::Reclaim()
+      {
+        std::lock_guard<std::mutex> lock(_WriterMutex);
+        const auto result = ReclaimUnlocked();
+        return result;
+      }
+
+      template <typename TDictionary, typename TSize, size_t SlotCount>
+      size_t DictionaryHolder<TDictionary, TSize, SlotCount>::ReclaimUnlocked()
+      {
+        if (_Retired.empty())
+        {
+          return 0;
+        }
+
+        //The oldest epoch of a busy slot.
+        auto oldest = _Epoch.load();
+        for (const auto& slot : _Slots)
+        {
+          const auto epoch = slot.Epoch.load();
+          if (IdleEpoch != epoch && epoch < oldest)
+          {
+            oldest = epoch;
+          }
+        }
+
+        //A reader, having pinned at the "epoch", might have loaded the snapshot
+        // retired at that epoch, but not the ones retired before it.
+        _Retired.erase(std::remove_if(_Retired.begin(), _Retired.end(),
+          [oldest](const std::pair<std::uint64_t, std::unique_ptr<const Snapshot>>& retired)
+        {
+          return retired.first < oldest;
+        }), _Retired.end());
+
+        return _Retired.size();
+      }
+    }
+  }
+}
@@ -0,0 +1,411 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //An immutable set of words, compiled into a double-array trie.
+      //A transition is two array reads: "Base[state] + letter" must be
+      // checked against the "Check" to belong to the "state".
+      //
+      //Unlike a hash set, there is no need to build a substring:
+      // the trie is walked forward from an offset,
+      // and every word, starting there, is reported in one pass.
+      //
+      //Each distinct word gets an id in [0, size()),
+      // in the lexicographical order of the words.
+      template <typename TSize = size_t>
+      class DoubleArrayTrie final
+      {
+      public:
+
+        using TIndex = std::uint32_t;
+
+        static constexpr size_t NotFound = static_cast<size_t>(-1);
+
+        static constexpr TIndex RootState = 1;
+
+        template <typename TIterator>
+        DoubleArrayTrie(TIterator begin, TIterator end);
+
+        template <typename TWords>
+        explicit DoubleArrayTrie(const TWords& words)
+          : DoubleArrayTrie(words.begin(), words.end())
+        {
+        }
+
+        inline size_t size() const
+        {
+          return _Size;
+        }
+
+        inline bool empty() const
+        {
+          return 0 == _Size;
+        }
+
+        inline TSize get_MaxLength() const
+        {
+          return _MaxLength;
+        }
+
+        //Return the word id, or NotFound.
+        size_t find(const char* word, const size_t length) const;
+
+        //Call the "action(length, wordId)" for every word
+        // being a prefix of [begin, end), the shortest word first.
+        template <typename TAction>
+        void ForEachPrefix(const char* begin, const char* end, TAction action) const;
+
+        //The states are in [RootState, get_StateCount()), some of them are unused.
+        inline size_t get_StateCount() const
+        {
+          return _Cells.size();
+        }
+
+        //Return 0 when there is no transition.
+        inline TIndex Next(const TIndex state, const char letter) const
+        {
+          const auto target = static_cast<size_t>(_Cells[state].Base) + Code(letter);
+          const auto result = target < _Cells.size() && state == _Cells[target].Check
+            ? static_cast<TIndex>(target)
+            : TIndex(0);
+          return result;
+        }
+
+        //Call the "action(letter, childState)" for every child of the "state",
+        // in the order of the letters.
+        template <typename TAction>
+        void ForEachChild(const TIndex state, TAction action) const;
+
+        //Return the id of the word ending in the "state", or NotFound.
+        inline size_t WordId(const TIndex state) const
+        {
+          const auto wordId = _Cells[state].WordId;
+          const auto result = NoWord == wordId ? NotFound : static_cast<size_t>(wordId);
+          return result;
+        }
+
+      private:
+
+        struct Cell final
+        {
+          TIndex Base;
+          //The parent state, 0 for a free cell.
+          TIndex Check;
+          TIndex WordId;
+        };
+
+        static constexpr TIndex NoWord = std::numeric_limits<TIndex>::max();
+
+        //A free cell, which has failed to take the first child so many times,
+        // is skipped as the first child afterwards; see the FindBase.
+        static constexpr unsigned char MaxFailures = 32;
+
+        std::vector<Cell> _Cells;
+
+        //The children are linked, 0 being the end, for the ForEachChild.
+        //They are kept apart from the cells not to slow down the Next.
+        std::vector<TIndex> _FirstChildren;
+        std::vector<TIndex> _NextSiblings;
+
+        size_t _Size;
+        TSize _MaxLength;
+
+        //The letter 0 is mapped to 1 so that a child never lands on its parent base.
+        static inline TIndex Code(const char letter)
+        {
+          return static_cast<TIndex>(static_cast<unsigned char>(letter)) + 1;
+        }
+
+        void Build(const std::vector<std::string>& words);
+
+        //The "nextFree[cell]" leads to the first free cell at or after the "cell":
+        // an occupied cell points further, and the paths are compressed.
+        //The cells past the end are free.
+        //The "failures[cell]" counts the bases, rejected with the first child at the free "cell".
+        TIndex FindBase(const std::vector<TIndex>& codes,
+          std::vector<size_t>& nextFree, std::vector<unsigned char>& failures);
+
+        static size_t FindFree(std::vector<size_t>& nextFree, size_t cell);
+      };
+
+      template <typename TSize>
+      template <typename TIterator>
+      DoubleArrayTrie<TSize>::DoubleArrayTrie(TIterator begin, TIterator end)
+        : _Size(0), _MaxLength(0)
+      {
+        std::vector<std::string> words(begin, end);
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+
+        if (static_cast<size_t>(NoWord) <= words.size())
+        {
+          std::ostringstream ss;
+          ss << "Too many words (" << words.size() << ") for the DoubleArrayTrie.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        Build(words);
+      }
+
+      template <typename TSize>
+      size_t DoubleArrayTrie<TSize>::find(const char* word, const size_t length) const
+      {
+        TIndex state = RootState;
+        for (size_t index = 0; index < length; ++index)
+        {
+          state = Next(state, word[index]);
+          if (0 == state)
+          {
+            return NotFound;
+          }
+        }
+
+        const auto result = WordId(state);
+        return result;
+      }
+
+      template <typename TSize>
+      template <typename TAction>
+      void DoubleArrayTrie<TSize>::ForEachPrefix(
+        const char* begin, const char* end, TAction action) const
+      {
+        TIndex state = RootState;
+        for (auto current = begin; current != end;)
+        {
+          state = Next(state, *current);
+          if (0 == state)
+          {
+            break;
+          }
+
+          ++current;
+
+          const auto wordId = _Cells[state].WordId;
+          if (NoWord != wordId)
+          {
+            action(static_cast<TSize>(current - begin), static_cast<size_t>(wordId));
+          }
+        }
+      }
+
+      template <typename TSize>
+      template <typename TAction>
+      void DoubleArrayTrie<TSize>::ForEachChild(const TIndex state, TAction action) const
+      {
+        const auto base = _Cells[state].Base;
+        for (auto child = _FirstChildren[state]; 0 != child; child = _NextSiblings[child])
+        {
+          const auto letter = static_cast<char>(static_cast<unsigned char>(child - base - 1));
+          action(letter, child);
+        }
+      }
+
+      template <typename TSize>
+      void DoubleArrayTrie<TSize>::Build(const std::vector<std::string>& words)
+      {
+        //Node: state, the range [first, last) of the words sharing the prefix of "depth".
+        struct Node final
+        {
+          TIndex State;
+          size_t First;
+          size_t Last;
+          size_t Depth;
+        };
+
+        _Cells.resize(RootState + 1, Cell{ 0, 0, NoWord });
+        _Cells[RootState].Check = RootState;
+
+        size_t maxLength = 0;
+
+        std::vector<size_t> nextFree(RootState + 1, RootState + 1);
+        std::vector<unsigned char> failures(RootState + 1, 0);
+
+        std::queue<Node> nodes;
+        nodes.push({ RootState, 0, words.size(), 0 });
+
+        std::vector<TIndex> codes;
+        std::vector<Node> children;
+
+        while (!nodes.empty())
+        {
+          const auto node = nodes.front();
+          nodes.pop();
+
+          auto first = node.First;
+          if (first < node.Last && words[first].size() == node.Depth)
+          {//The words are sorted, so the prefix itself comes first.
+            if (0 == node.Depth)
+            {
+              throw std::runtime_error("An empty word cannot be in the dictionary.");
+            }
+
+            _Cells[node.State].WordId = static_cast<TIndex>(first);
+            ++first;
+          }
+
+          codes.clear();
+          children.clear();
+          while (first < node.Last)
+          {
+            const auto letter = words[first][node.Depth];
+
+            auto last = first + 1;
+            while (last < node.Last && letter == words[last][node.Depth])
+            {
+              ++last;
+            }
+
+            codes.push_back(Code(letter));
+            children.push_back({ 0, first, last, node.Depth + 1 });
+            first = last;
+          }
+
+          if (codes.empty())
+          {
+            if (maxLength < node.Depth)
+            {
+              maxLength = node.Depth;
+            }
+
+            continue;
+          }
+
+          const auto base = FindBase(codes, nextFree, failures);
+          _Cells[node.State].Base = base;
+
+          if (_FirstChildren.size() < _Cells.size())
+          {
+            _FirstChildren.resize(_Cells.size(), 0);
+            _NextSiblings.resize(_Cells.size(), 0);
+          }
+
+          for (size_t index = 0; index < codes.size(); ++index)
+          {
+            auto& child = children[index];
+            child.State = base + codes[index];
+            _Cells[child.State].Check = node.State;
+            nextFree[child.State] = child.State + 1;
+            nodes.push(child);
+
+            if (0 < index)
+            {
+              _NextSiblings[children[index - 1].State] = child.State;
+            }
+          }
+
+          _FirstChildren[node.State] = children.front().State;
+        }
+
+        _Size = words.size();
+        _MaxLength = static_cast<TSize>(maxLength);
+        if (static_cast<size_t>(_MaxLength) != maxLength)
+        {
+          std::ostringstream ss;
+          ss << "Too long words are not supported: "
+            << maxLength << " as TSize is " << _MaxLength
+            << ". Consider replacing TSize.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        _Cells.shrink_to_fit();
+        _FirstChildren.resize(_Cells.size(), 0);
+        _NextSiblings.resize(_Cells.size(), 0);
+      }
+
+      template <typename TSize>
+      typename DoubleArrayTrie<TSize>::TIndex
+        DoubleArrayTrie<TSize>::FindBase(
+          const std::vector<TIndex>& codes,
+          std::vector<size_t>& nextFree, std::vector<unsigned char>& failures)
+      {
+        //The codes are sorted; only the bases, putting the first code
+        // into a free cell, are tried, so that the occupied cells are skipped.
+        //When the array is dense, the few free cells at the beginning
+        // would be tried by every node with many children, which is quadratic;
+        // thus a free cell, having failed "MaxFailures" times, is skipped by the "nextFree",
+        // though it can still take the other children.
+        size_t base = 0;
+        for (auto cell = FindFree(nextFree, codes[0] + 1);; cell = FindFree(nextFree, cell + 1))
+        {
+          base = cell - codes[0];
+
+          const auto lastCell = base + codes.back();
+          if (_Cells.size() <= lastCell)
+          {
+            _Cells.resize(lastCell + 1, Cell{ 0, 0, NoWord });
+          }
+
+          auto isFree = true;
+          for (size_t index = 1; index < codes.size(); ++index)
+          {
+            if (0 != _Cells[base + codes[index]].Check)
+            {
+              isFree = false;
+              break;
+            }
+          }
+
+          if (isFree)
+          {
+            break;
+          }
+
+          if (cell < failures.size() && MaxFailures <= ++failures[cell])
+          {
+            nextFree[cell] = cell + 1;
+          }
+        }
+
+        if (static_cast<size_t>(NoWord) <= base + codes.back())
+        {
+          throw std::runtime_error("The DoubleArrayTrie has run out of indexes.");
+        }
+
+        const auto oldSize = nextFree.size();
+        if (oldSize < _Cells.size())
+        {
+          nextFree.resize(_Cells.size());
+          failures.resize(_Cells.size(), 0);
+          for (auto cell = oldSize; cell < nextFree.size(); ++cell)
+          {
+            nextFree[cell] = cell;
+          }
+        }
+
+        return static_cast<TIndex>(base);
+      }
+
+      template <typename TSize>
+      size_t DoubleArrayTrie<TSize>::FindFree(std::vector<size_t>& nextFree, size_t cell)
+      {
+        auto result = cell;
+        while (result < nextFree.size() && result != nextFree[result])
+        {
+          result = nextFree[result];
+        }
+
+        while (cell < nextFree.size() && cell != nextFree[cell])
+        {
+          const auto next = nextFree[cell];
+          nextFree[cell] = result;
+          cell = next;
+        }
+
+        return result;
+      }
+    }
+  }
+}
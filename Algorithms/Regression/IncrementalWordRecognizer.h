@@ -0,0 +1,427 @@
+#pragma once
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DoubleArrayTrie.h"
+#include "WordPosition.h"
+#include "WordScoring.h"
+#include "../ExceptionUtilities.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //Keeps a text together with its DP tables, and the best segmentation,
+      // the same as returned by the WordRecognizer for a DoubleArrayTrie.
+      //
+      //When a range of the text is replaced, the DP is recomputed
+      // only from the edit point.
+      //A step only looks back |longest word| positions, so once that many
+      // new weights after the edit differ from the old ones by the same constant,
+      // the rest of the tables is the old one: the weights are shifted by that constant,
+      // and the best choices are the same.
+      //The segmentation is then patched between the edit and the convergence point.
+      //
+      //The shift of the weights after the convergence point is lazy:
+      // it is applied only to the positions between two consecutive edits.
+      //
+      //The DP work per edit is typically O(|edit| + |longest word|
+      // + |distance from the previous edit|),
+      // while the tables and the text are moved by the length change as a std::string is.
+      template <typename TSize = size_t,
+        typename TWeight = long long,
+        typename TScoring = CubeScoring<TWeight>>
+      class IncrementalWordRecognizer final
+      {
+        static_assert(TScoring::IsUnknownSplittable,
+          "Only the single unknown letters are tried, see the TScoring::IsUnknownSplittable.");
+
+      public:
+
+        using WordPosition = WordPosition<TSize>;
+
+        //The "words" are referenced, and must outlive the recognizer.
+        explicit IncrementalWordRecognizer(
+          const DoubleArrayTrie<TSize>& words,
+          const std::string& text = {});
+
+        explicit IncrementalWordRecognizer(
+          DoubleArrayTrie<TSize>&& words,
+          const std::string& text = {}) = delete;
+
+        //Replace the "length" letters at the "offset" with the "replacement".
+        void Replace(const size_t offset, const size_t length,
+          const std::string& replacement);
+
+        inline const std::string& get_Text() const
+        {
+          return _Text;
+        }
+
+        inline TWeight get_Weight() const
+        {
+          return WeightAt(_Text.size());
+        }
+
+        inline const std::vector<WordPosition>& get_Positions() const
+        {
+          return _Positions;
+        }
+
+        //The number of the DP positions, recomputed by the last edit.
+        inline size_t get_RecomputedCount() const
+        {
+          return _RecomputedCount;
+        }
+
+      private:
+
+        const DoubleArrayTrie<TSize>& _Words;
+        const size_t _MaxLength;
+
+        std::string _Text;
+
+        //The best weight of the prefix of the given length,
+        // less by the _Shift starting from the _ShiftBegin.
+        std::vector<TWeight> _Weights;
+        size_t _ShiftBegin;
+        TWeight _Shift;
+
+        //The last word length of the best prefix of the "index + 1" letters.
+        std::vector<TSize> _Lengths;
+
+        std::vector<WordPosition> _Positions;
+
+        size_t _RecomputedCount;
+
+        //The buffers for the recomputed positions.
+        std::vector<TWeight> _NewWeights;
+        std::vector<TSize> _NewLengths;
+        std::vector<WordPosition> _NewPositions;
+
+        inline TWeight WeightAt(const size_t position) const
+        {
+          const auto result = _ShiftBegin <= position
+            ? _Weights[position] + _Shift
+            : _Weights[position];
+          return result;
+        }
+
+        //Apply the _Shift to the weights between the _ShiftBegin and the "shiftBegin".
+        void MoveShift(const size_t shiftBegin);
+
+        //Recompute the DP after the "offset", till it converges.
+        //Return the last recomputed position, and set the "delta"
+        // to be added to the weights after it.
+        size_t Recompute(const size_t offset,
+          const size_t editEnd,
+          const size_t oldEditEnd,
+          TWeight& delta);
+
+        //Patch the segmentation, given the DP has changed in (offset, converged].
+        void PatchPositions(const size_t offset,
+          const size_t converged,
+          const size_t oldConverged,
+          const size_t removedLength,
+          const size_t insertedLength);
+
+        //Replace the items [begin, oldEnd) with the "source".
+        template <typename T>
+        static void Splice(std::vector<T>& target,
+          const size_t begin, const size_t oldEnd,
+          const std::vector<T>& source);
+      };
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      IncrementalWordRecognizer<TSize, TWeight, TScoring>::IncrementalWordRecognizer(
+        const DoubleArrayTrie<TSize>& words,
+        const std::string& text)
+        : _Words(words),
+        _MaxLength(std::max(static_cast<size_t>(words.get_MaxLength()), size_t(1))),
+        _Weights(1, TWeight()),
+        _ShiftBegin(1),
+        _Shift(),
+        _RecomputedCount(0)
+      {
+        ThrowIfEmpty(words, "words");
+        Replace(0, 0, text);
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      void IncrementalWordRecognizer<TSize, TWeight, TScoring>::Replace(
+        const size_t offset, const size_t length,
+        const std::string& replacement)
+      {
+        const auto oldSize = _Text.size();
+        if (oldSize < offset || oldSize - offset < length)
+        {
+          std::ostringstream ss;
+          ss << "The range [" << offset << ", " << offset << " + " << length
+            << ") must be within the text of size " << oldSize << ".";
+          StreamUtilities::ThrowException<std::out_of_range>(ss);
+        }
+
+        if (static_cast<size_t>(std::numeric_limits<TSize>::max())
+          < oldSize - length + replacement.size())
+        {
+          std::ostringstream ss;
+          ss << "The text is too long, " << (oldSize - length + replacement.size())
+            << " letters. Consider replacing TSize.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        _Text.replace(offset, length, replacement);
+
+        const auto editEnd = offset + replacement.size();
+        const auto oldEditEnd = offset + length;
+
+        TWeight delta{};
+        const auto converged = Recompute(offset, editEnd, oldEditEnd, delta);
+        const auto oldConverged = converged - editEnd + oldEditEnd;
+        _RecomputedCount = converged - offset;
+
+        PatchPositions(offset, converged, oldConverged, length, replacement.size());
+
+        MoveShift(oldConverged + 1);
+        Splice(_Weights, offset + 1, oldConverged + 1, _NewWeights);
+        _ShiftBegin = converged + 1;
+        _Shift += delta;
+
+        Splice(_Lengths, offset, oldConverged, _NewLengths);
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      void IncrementalWordRecognizer<TSize, TWeight, TScoring>::MoveShift(
+        const size_t shiftBegin)
+      {
+        for (auto index = _ShiftBegin; index < shiftBegin; ++index)
+        {
+          _Weights[index] += _Shift;
+        }
+
+        for (auto index = shiftBegin; index < _ShiftBegin; ++index)
+        {
+          _Weights[index] -= _Shift;
+        }
+
+        _ShiftBegin = shiftBegin;
+      }
+
+      //The words are relaxed forward from the offsets, which can reach past the "offset".
+      //The new weights of the positions "offset + 1 + index" are in the _NewWeights[index].
+      template <typename TSize, typename TWeight, typename TScoring>
+      size_t IncrementalWordRecognizer<TSize, TWeight, TScoring>::Recompute(
+        const size_t offset,
+        const size_t editEnd,
+        const size_t oldEditEnd,
+        TWeight& delta)
+      {
+        const auto size = _Text.size();
+        const auto textEnd = _Text.data() + size;
+
+        const auto weightAt = [&](const size_t position)
+        {
+          return position <= offset
+            ? WeightAt(position)
+            : _NewWeights[position - offset - 1];
+        };
+
+        const auto relax = [&](const size_t begin, const size_t wordLength,
+          const TWeight currentWeight)
+        {
+          const auto end = begin + wordLength;
+          auto& weight = _NewWeights[end - offset - 1];
+          if (weight < currentWeight)
+          {
+            weight = currentWeight;
+            _NewLengths[end - offset - 1] = static_cast<TSize>(wordLength);
+          }
+        };
+
+        _NewWeights.clear();
+        _NewLengths.clear();
+
+        //The number of the last positions, shifted by the same "delta".
+        size_t agreed = 0;
+
+        for (auto begin = offset < _MaxLength ? 0 : offset + 1 - _MaxLength;
+          begin < size; ++begin)
+        {
+          const auto reach = std::min(begin + _MaxLength, size);
+          if (offset < reach && _NewWeights.size() < reach - offset)
+          {
+            _NewWeights.resize(reach - offset, std::numeric_limits<TWeight>::min());
+            _NewLengths.resize(reach - offset);
+          }
+
+          const auto initialSequenceWeight = weightAt(begin);
+          auto isKnownLetter = false;
+
+          _Words.ForEachPrefix(_Text.data() + begin, textEnd,
+            [&](const TSize wordLength, const size_t)
+          {
+            if (1 == wordLength)
+            {
+              isKnownLetter = true;
+            }
+            else if (offset < begin + wordLength)
+            {
+              relax(begin, wordLength, initialSequenceWeight
+                + TScoring::Known(NoPayload(), static_cast<TWeight>(wordLength)));
+            }
+          });
+
+          if (begin < offset)
+          {
+            continue;
+          }
+
+          relax(begin, 1, initialSequenceWeight + (isKnownLetter
+            ? TScoring::Known(NoPayload(), TWeight(1))
+            : TScoring::Unknown(1)));
+
+          //The "end" is final now.
+          //Its words are in the old text, when they start after the edit.
+          const auto end = begin + 1;
+          if (end < editEnd + _MaxLength)
+          {
+            continue;
+          }
+
+          const auto currentDelta = weightAt(end) - WeightAt(end - editEnd + oldEditEnd);
+          if (0 < agreed && currentDelta == delta)
+          {
+            ++agreed;
+          }
+          else
+          {
+            agreed = 1;
+            delta = currentDelta;
+          }
+
+          if (_MaxLength <= agreed)
+          {
+            _NewWeights.resize(end - offset);
+            _NewLengths.resize(end - offset);
+            return end;
+          }
+        }
+
+        _NewWeights.resize(size - offset);
+        _NewLengths.resize(size - offset);
+        return size;
+      }
+
+      //The old and the new best chains are the same after the "converged".
+      //Before it, the new chain is followed back till it joins the old one,
+      // not later than at the "offset".
+      template <typename TSize, typename TWeight, typename TScoring>
+      void IncrementalWordRecognizer<TSize, TWeight, TScoring>::PatchPositions(
+        const size_t offset,
+        const size_t converged,
+        const size_t oldConverged,
+        const size_t removedLength,
+        const size_t insertedLength)
+      {
+        const auto endOf = [](const WordPosition& position)
+        {
+          return static_cast<size_t>(position.get_Offset()) + position.get_Length();
+        };
+
+        const auto lengthAt = [&](const size_t end)
+        {
+          return end <= offset
+            ? static_cast<size_t>(_Lengths[end - 1])
+            : end <= converged
+            ? static_cast<size_t>(_NewLengths[end - offset - 1])
+            : static_cast<size_t>(_Lengths[end - converged + oldConverged - 1]);
+        };
+
+        //The first old word, ending after the convergence.
+        const auto kept = std::upper_bound(_Positions.begin(), _Positions.end(), oldConverged,
+          [&](const size_t position, const WordPosition& word)
+        {
+          return position < endOf(word);
+        });
+
+        auto end = _Positions.end() == kept
+          ? _Text.size()
+          : static_cast<size_t>(kept->get_Offset()) - removedLength + insertedLength;
+
+        _NewPositions.clear();
+
+        auto joined = _Positions.begin();
+        while (0 < end)
+        {
+          if (end <= offset)
+          {
+            joined = std::lower_bound(_Positions.begin(), kept, end,
+              [&](const WordPosition& word, const size_t position)
+            {
+              return endOf(word) < position;
+            });
+
+            if (kept != joined && endOf(*joined) == end)
+            {
+              ++joined;
+              break;
+            }
+          }
+
+          const auto length = lengthAt(end);
+          end -= length;
+          _NewPositions.push_back({ static_cast<TSize>(end), static_cast<TSize>(length) });
+        }
+
+        if (0 == end)
+        {
+          joined = _Positions.begin();
+        }
+
+        if (removedLength != insertedLength)
+        {
+          for (auto it = kept; it != _Positions.end(); ++it)
+          {
+            *it = { static_cast<TSize>(it->get_Offset() - removedLength + insertedLength),
+              it->get_Length() };
+          }
+        }
+
+        std::reverse(_NewPositions.begin(), _NewPositions.end());
+        Splice(_Positions,
+          static_cast<size_t>(joined - _Positions.begin()),
+          static_cast<size_t>(kept - _Positions.begin()),
+          _NewPositions);
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      template <typename T>
+      void IncrementalWordRecognizer<TSize, TWeight, TScoring>::Splice(
+        std::vector<T>& target,
+        const size_t begin, const size_t oldEnd,
+        const std::vector<T>& source)
+      {
+        const auto oldCount = oldEnd - begin;
+        const auto common = std::min(oldCount, source.size());
+
+        std::copy(source.begin(), source.begin() + common, target.begin() + begin);
+
+        if (common < oldCount)
+        {
+          target.erase(target.begin() + (begin + common), target.begin() + oldEnd);
+        }
+        else
+        {
+          target.insert(target.begin() + oldEnd, source.begin() + common, source.end());
+        }
+      }
+    }
+  }
+}
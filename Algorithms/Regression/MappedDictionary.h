@@ -0,0 +1,465 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../MemoryMappedFile.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //A read-only dictionary, stored in a file, which is mapped into the memory.
+      //Opening reads no words, only validates the offsets and the slots in one pass,
+      // and the pages are shared among the processes.
+      //It can be used as the TDictionary of the WordRecognizer.
+      //
+      //The file layout, in the native byte order, 8-byte aligned sections:
+      // - The Header.
+      // - The length histogram: uint64[MaxLength + 1], the word count by length.
+      // - The perfect hash displacements: uint32[BucketCount].
+      // - The perfect hash slots: uint32[SlotCount], a word index + 1, or 0 if free.
+      // - The word offsets: uint64[WordCount + 1] into the letters.
+      // - The letters of the sorted words.
+      //
+      //The perfect hash is "hash and displace":
+      // a word goes to a bucket, and the bucket displacement selects the slot,
+      // so that a search makes one slot probe and one word comparison.
+      class MappedDictionary final
+      {
+      public:
+
+        class const_iterator final
+        {
+          const MappedDictionary* _Dictionary;
+          size_t _Index;
+
+        public:
+
+          using iterator_category = std::forward_iterator_tag;
+          using value_type = std::string;
+          using difference_type = std::ptrdiff_t;
+          using pointer = void;
+          using reference = std::string;
+
+          const_iterator(const MappedDictionary* dictionary = nullptr, size_t index = 0)
+            : _Dictionary(dictionary), _Index(index)
+          {
+          }
+
+          inline std::string operator *() const
+          {
+            return _Dictionary->word(_Index);
+          }
+
+          inline size_t get_Index() const
+          {
+            return _Index;
+          }
+
+          inline const_iterator& operator ++()
+          {
+            ++_Index;
+            return *this;
+          }
+
+          inline const_iterator operator ++(int)
+          {
+            auto result = *this;
+            ++_Index;
+            return result;
+          }
+
+          inline bool operator ==(const const_iterator& other) const
+          {
+            return _Index == other._Index;
+          }
+
+          inline bool operator !=(const const_iterator& other) const
+          {
+            return _Index != other._Index;
+          }
+        };
+
+        using iterator = const_iterator;
+
+        explicit MappedDictionary(const std::string& path)
+          : _File(path)
+        {
+          Validate(path);
+        }
+
+        //Sort the "words", and save them in the "path".
+        template <typename TWords>
+        static void Write(const std::string& path, const TWords& words);
+
+        inline size_t size() const
+        {
+          return static_cast<size_t>(_Header->WordCount);
+        }
+
+        inline bool empty() const
+        {
+          return 0 == _Header->WordCount;
+        }
+
+        inline size_t get_MaxLength() const
+        {
+          return static_cast<size_t>(_Header->MaxLength);
+        }
+
+        //The number of words of the "length".
+        inline size_t get_LengthCount(const size_t length) const
+        {
+          const auto result = length <= _Header->MaxLength
+            ? static_cast<size_t>(_Histogram[length])
+            : size_t(0);
+          return result;
+        }
+
+        inline const_iterator begin() const
+        {
+          return const_iterator(this, 0);
+        }
+
+        inline const_iterator end() const
+        {
+          return const_iterator(this, size());
+        }
+
+        //The words are sorted, and the index is in [0, size()).
+        inline std::string word(const size_t index) const
+        {
+          const auto offset = static_cast<size_t>(_Offsets[index]);
+          const auto length = static_cast<size_t>(_Offsets[index + 1]) - offset;
+          return std::string(_Letters + offset, length);
+        }
+
+        const_iterator find(const char* word, const size_t length) const;
+
+        inline const_iterator find(const std::string& word) const
+        {
+          return find(word.data(), word.size());
+        }
+
+      private:
+
+        struct Header final
+        {
+          char Magic[8];
+          std::uint64_t Version;
+          std::uint64_t WordCount;
+          std::uint64_t MaxLength;
+          std::uint64_t BucketCount;
+          std::uint64_t SlotCount;
+          std::uint64_t LetterCount;
+        };
+
+        static constexpr std::uint64_t CurrentVersion = 1;
+
+        static const char* Magic()
+        {
+          return "WORDDICT";
+        }
+
+        MemoryMappedFile _File;
+
+        const Header* _Header;
+        const std::uint64_t* _Histogram;
+        const std::uint32_t* _Displacements;
+        const std::uint32_t* _Slots;
+        const std::uint64_t* _Offsets;
+        const char* _Letters;
+
+        static inline size_t Align(const size_t size)
+        {
+          return (size + 7) & ~size_t(7);
+        }
+
+        static inline std::uint64_t Mix(std::uint64_t value)
+        {//The splitmix64 finalizer.
+          value ^= value >> 30;
+          value *= 0xbf58476d1ce4e5b9ULL;
+          value ^= value >> 27;
+          value *= 0x94d049bb133111ebULL;
+          value ^= value >> 31;
+          return value;
+        }
+
+        static inline std::uint64_t Hash(const char* word, const size_t length)
+        {//FNV-1a.
+          std::uint64_t result = 0xcbf29ce484222325ULL;
+          for (size_t index = 0; index < length; ++index)
+          {
+            result ^= static_cast<unsigned char>(word[index]);
+            result *= 0x100000001b3ULL;
+          }
+
+          return result;
+        }
+
+        static inline size_t Bucket(const std::uint64_t hash, const std::uint64_t bucketCount)
+        {
+          return static_cast<size_t>(Mix(hash) % bucketCount);
+        }
+
+        static inline size_t Slot(const std::uint64_t hash,
+          const std::uint32_t displacement, const std::uint64_t slotCount)
+        {
+          return static_cast<size_t>(
+            Mix(hash + (displacement + 1ULL) * 0x9e3779b97f4a7c15ULL) % slotCount);
+        }
+
+        void Validate(const std::string& path);
+      };
+
+      inline MappedDictionary::const_iterator MappedDictionary::find(
+        const char* word, const size_t length) const
+      {
+        if (_Header->MaxLength < length || 0 == _Histogram[length])
+        {
+          return end();
+        }
+
+        const auto hash = Hash(word, length);
+        const auto displacement = _Displacements[Bucket(hash, _Header->BucketCount)];
+        const auto slot = _Slots[Slot(hash, displacement, _Header->SlotCount)];
+        if (0 == slot)
+        {
+          return end();
+        }
+
+        const auto index = static_cast<size_t>(slot - 1);
+        const auto offset = static_cast<size_t>(_Offsets[index]);
+        const auto isFound = length == static_cast<size_t>(_Offsets[index + 1]) - offset
+          && 0 == std::memcmp(_Letters + offset, word, length);
+
+        const auto result = isFound ? const_iterator(this, index) : end();
+        return result;
+      }
+
+      template <typename TWords>
+      void MappedDictionary::Write(const std::string& path, const TWords& words)
+      {
+        std::vector<std::string> sorted(words.begin(), words.end());
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+        const auto wordCount = static_cast<std::uint64_t>(sorted.size());
+        if (static_cast<std::uint64_t>(UINT32_MAX) <= wordCount)
+        {
+          std::ostringstream ss;
+          ss << "Too many words (" << wordCount << ") for the MappedDictionary.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        Header header{};
+        std::memcpy(header.Magic, Magic(), sizeof header.Magic);
+        header.Version = CurrentVersion;
+        header.WordCount = wordCount;
+        //About 4 words in a bucket, and 20% of the slots are free.
+        header.BucketCount = wordCount / 4 + 1;
+        header.SlotCount = wordCount + wordCount / 4 + 1;
+
+        std::vector<std::uint64_t> offsets;
+        offsets.reserve(sorted.size() + 1);
+        offsets.push_back(0);
+
+        for (const auto& word : sorted)
+        {
+          if (word.empty())
+          {
+            throw std::runtime_error("An empty word cannot be in the dictionary.");
+          }
+
+          header.MaxLength = std::max<std::uint64_t>(header.MaxLength, word.size());
+          offsets.push_back(offsets.back() + word.size());
+        }
+
+        header.LetterCount = offsets.back();
+
+        std::vector<std::uint64_t> histogram(static_cast<size_t>(header.MaxLength) + 1);
+        std::vector<std::vector<std::uint32_t>> buckets(static_cast<size_t>(header.BucketCount));
+        std::vector<std::uint64_t> hashes(sorted.size());
+
+        for (size_t index = 0; index < sorted.size(); ++index)
+        {
+          const auto& word = sorted[index];
+          ++histogram[word.size()];
+
+          hashes[index] = Hash(word.data(), word.size());
+          buckets[Bucket(hashes[index], header.BucketCount)]
+            .push_back(static_cast<std::uint32_t>(index));
+        }
+
+        //The large buckets are placed first, while there are many free slots.
+        std::vector<std::uint32_t> bucketOrder(buckets.size());
+        for (size_t index = 0; index < buckets.size(); ++index)
+        {
+          bucketOrder[index] = static_cast<std::uint32_t>(index);
+        }
+
+        std::stable_sort(bucketOrder.begin(), bucketOrder.end(),
+          [&](const std::uint32_t a, const std::uint32_t b)
+        {
+          return buckets[b].size() < buckets[a].size();
+        });
+
+        std::vector<std::uint32_t> displacements(buckets.size());
+        std::vector<std::uint32_t> slots(static_cast<size_t>(header.SlotCount));
+        std::vector<size_t> taken;
+
+        for (const auto bucketIndex : bucketOrder)
+        {
+          const auto& bucket = buckets[bucketIndex];
+          if (bucket.empty())
+          {
+            break;
+          }
+
+          constexpr std::uint32_t maxDisplacement = 1u << 24;
+          std::uint32_t displacement = 0;
+          for (;; ++displacement)
+          {
+            if (maxDisplacement == displacement)
+            {
+              throw std::runtime_error("Cannot build the perfect hash for the MappedDictionary.");
+            }
+
+            taken.clear();
+            for (const auto index : bucket)
+            {
+              const auto slot = Slot(hashes[index], displacement, header.SlotCount);
+              if (0 != slots[slot]
+                || taken.end() != std::find(taken.begin(), taken.end(), slot))
+              {
+                break;
+              }
+
+              taken.push_back(slot);
+            }
+
+            if (taken.size() == bucket.size())
+            {
+              break;
+            }
+          }
+
+          displacements[bucketIndex] = displacement;
+          for (size_t index = 0; index < bucket.size(); ++index)
+          {
+            slots[taken[index]] = bucket[index] + 1;
+          }
+        }
+
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+        const auto writeSection = [&](const void* data, const size_t size)
+        {
+          static const char padding[8] = {};
+
+          output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+          output.write(padding, static_cast<std::streamsize>(Align(size) - size));
+        };
+
+        writeSection(&header, sizeof header);
+        writeSection(histogram.data(), histogram.size() * sizeof(std::uint64_t));
+        writeSection(displacements.data(), displacements.size() * sizeof(std::uint32_t));
+        writeSection(slots.data(), slots.size() * sizeof(std::uint32_t));
+        writeSection(offsets.data(), offsets.size() * sizeof(std::uint64_t));
+
+        for (const auto& word : sorted)
+        {
+          output.write(word.data(), static_cast<std::streamsize>(word.size()));
+        }
+
+        output.flush();
+        if (!output)
+        {
+          std::ostringstream ss;
+          ss << "Cannot write the dictionary file '" << path << "'.";
+          StreamUtilities::ThrowException(ss);
+        }
+      }
+
+      inline void MappedDictionary::Validate(const std::string& path)
+      {
+        const auto fileSize = _File.size();
+        const auto data = _File.data();
+
+        size_t size = 0;
+        auto isValid = true;
+
+        //Take the section of the "count" items, the counts in the file being untrusted.
+        const auto takeSection = [&](const std::uint64_t count, const size_t itemSize,
+          const bool isAligned) -> const char*
+        {
+          if (!isValid || fileSize < size || (fileSize - size) / itemSize < count)
+          {
+            isValid = false;
+            return nullptr;
+          }
+
+          const auto result = data + size;
+          const auto bytes = static_cast<size_t>(count) * itemSize;
+          size += isAligned ? Align(bytes) : bytes;
+          return result;
+        };
+
+        _Header = reinterpret_cast<const Header*>(takeSection(1, sizeof(Header), true));
+        isValid = isValid
+          && 0 == std::memcmp(_Header->Magic, Magic(), sizeof(Header::Magic))
+          && CurrentVersion == _Header->Version
+          && 0 < _Header->BucketCount && 0 < _Header->SlotCount
+          //Thus the "MaxLength + 1" and "WordCount + 1" do not overflow.
+          && _Header->MaxLength < fileSize && _Header->WordCount < fileSize;
+
+        if (isValid)
+        {
+          _Histogram = reinterpret_cast<const std::uint64_t*>(
+            takeSection(_Header->MaxLength + 1, sizeof(std::uint64_t), true));
+          _Displacements = reinterpret_cast<const std::uint32_t*>(
+            takeSection(_Header->BucketCount, sizeof(std::uint32_t), true));
+          _Slots = reinterpret_cast<const std::uint32_t*>(
+            takeSection(_Header->SlotCount, sizeof(std::uint32_t), true));
+          _Offsets = reinterpret_cast<const std::uint64_t*>(
+            takeSection(_Header->WordCount + 1, sizeof(std::uint64_t), true));
+          _Letters = takeSection(_Header->LetterCount, 1, false);
+        }
+
+        isValid = isValid && fileSize == size && 0 == _Offsets[0]
+          && _Header->LetterCount == _Offsets[_Header->WordCount];
+
+        //Each word is not empty, and within both the letters and the MaxLength.
+        for (size_t index = 1; isValid && index <= _Header->WordCount; ++index)
+        {
+          const auto previous = _Offsets[index - 1];
+          const auto offset = _Offsets[index];
+          isValid = previous < offset && offset <= _Header->LetterCount
+            && offset - previous <= _Header->MaxLength;
+        }
+
+        //A slot is either free, or a word index + 1.
+        for (size_t index = 0; isValid && index < _Header->SlotCount; ++index)
+        {
+          isValid = _Slots[index] <= _Header->WordCount;
+        }
+
+        if (!isValid)
+        {
+          std::ostringstream ss;
+          ss << "The file '" << path << "' is not a valid dictionary, size=" << fileSize << ".";
+          StreamUtilities::ThrowException(ss);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,305 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <istream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "AhoCorasick.h"
+#include "WordPosition.h"
+#include "WordScoring.h"
+#include "../ExceptionUtilities.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //The same as the WordRecognizer, but the text comes in chunks
+      // of any size, e.g. from a huge file, and is never stored as a whole.
+      //
+      //Only the last "|longest word|" weights are kept,
+      // together with the unresolved back pointers.
+      //A split point is resolved when all the positions, which can still be
+      // extended by a future word, agree on it;
+      // then the words before that point are emitted, and forgotten.
+      //
+      //The emitted positions and the total weight are the same as
+      // returned by the WordRecognizer for the whole text.
+      template <typename TSize = size_t,
+        typename TWeight = long long,
+        typename TScoring = CubeScoring<TWeight>>
+      class StreamingWordRecognizer final
+      {
+        static_assert(TScoring::IsUnknownSplittable,
+          "Only the single unknown letters are tried, see the TScoring::IsUnknownSplittable.");
+
+      public:
+
+        using WordPosition = WordPosition<TSize>;
+
+        //The "words" are referenced, and must outlive the recognizer.
+        explicit StreamingWordRecognizer(const AhoCorasick<TSize>& words);
+
+        explicit StreamingWordRecognizer(AhoCorasick<TSize>&& words) = delete;
+
+        //Append the next chunk, which may be empty.
+        //The "emit(position)" is called for every resolved word, in the text order.
+        template <typename TEmit>
+        void Append(const char* data, const size_t size, TEmit emit);
+
+        //Emit the remaining words, and return the total weight.
+        //The recognizer can then be reused for another text.
+        template <typename TEmit>
+        TWeight Finish(TEmit emit);
+
+        //Read the "input" by blocks of the "bufferSize" till the end.
+        template <typename TEmit>
+        static TWeight Recognize(std::istream& input,
+          const AhoCorasick<TSize>& words,
+          TEmit emit,
+          const size_t bufferSize = 64 * 1024);
+
+        //The number of letters read so far.
+        inline TSize get_Size() const
+        {
+          return _Size;
+        }
+
+        //The number of letters after the last resolved split point.
+        inline TSize get_PendingSize() const
+        {
+          return _Size - _Resolved;
+        }
+
+      private:
+
+        const AhoCorasick<TSize>& _Words;
+        const TSize _MaxLength;
+
+        typename AhoCorasick<TSize>::TIndex _State;
+        TSize _Size;
+        TSize _Resolved;
+
+        //The weights of the positions [_Size + 1 - _Weights.size(), _Size].
+        std::deque<TWeight> _Weights;
+
+        //The best last word lengths of the positions (_Resolved, _Size].
+        std::deque<TSize> _Lengths;
+
+        std::vector<WordPosition> _Chain;
+
+        void Reset();
+
+        void AppendLetter(const char letter);
+
+        inline TWeight WeightAt(const TSize position) const
+        {
+          const auto first = _Size + 1 - static_cast<TSize>(_Weights.size());
+          return _Weights[position - first];
+        }
+
+        inline TSize LengthAt(const TSize position) const
+        {
+          return _Lengths[position - _Resolved - 1];
+        }
+
+        //The common split point of all the positions, extendable in the future.
+        TSize FindAgreedPosition() const;
+
+        //Emit the words in (_Resolved, end].
+        template <typename TEmit>
+        void EmitTill(const TSize end, TEmit& emit);
+      };
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      StreamingWordRecognizer<TSize, TWeight, TScoring>::StreamingWordRecognizer(
+        const AhoCorasick<TSize>& words)
+        : _Words(words), _MaxLength(words.get_MaxLength())
+      {
+        ThrowIfEmpty(words, "words");
+        Reset();
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      template <typename TEmit>
+      void StreamingWordRecognizer<TSize, TWeight, TScoring>::Append(
+        const char* data, const size_t size, TEmit emit)
+      {
+        for (size_t index = 0; index < size; ++index)
+        {
+          AppendLetter(data[index]);
+        }
+
+        const auto agreed = FindAgreedPosition();
+        if (_Resolved < agreed)
+        {
+          EmitTill(agreed, emit);
+        }
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      template <typename TEmit>
+      TWeight StreamingWordRecognizer<TSize, TWeight, TScoring>::Finish(TEmit emit)
+      {
+        if (0 == _Size)
+        {
+          throw std::runtime_error("The text must be not empty.");
+        }
+
+        EmitTill(_Size, emit);
+
+        const auto result = _Weights.back();
+        Reset();
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      template <typename TEmit>
+      TWeight StreamingWordRecognizer<TSize, TWeight, TScoring>::Recognize(
+        std::istream& input,
+        const AhoCorasick<TSize>& words,
+        TEmit emit,
+        const size_t bufferSize)
+      {
+        StreamingWordRecognizer recognizer(words);
+        std::vector<char> buffer(std::max(bufferSize, size_t(1)));
+
+        while (input)
+        {
+          input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+          recognizer.Append(buffer.data(), static_cast<size_t>(input.gcount()), emit);
+        }
+
+        const auto result = recognizer.Finish(emit);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      void StreamingWordRecognizer<TSize, TWeight, TScoring>::Reset()
+      {
+        _State = _Words.get_RootState();
+        _Size = 0;
+        _Resolved = 0;
+
+        _Weights.assign(1, TWeight());
+        _Lengths.clear();
+      }
+
+      //The matches come the longest first, that is from the smallest offset,
+      // and the unknown single letter is the last; see WordRecognizer.
+      template <typename TSize, typename TWeight, typename TScoring>
+      void StreamingWordRecognizer<TSize, TWeight, TScoring>::AppendLetter(const char letter)
+      {
+        if (std::numeric_limits<TSize>::max() == _Size)
+        {
+          std::ostringstream ss;
+          ss << "The text is too long, read " << _Size
+            << " letters. Consider replacing TSize.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        _State = _Words.Next(_State, letter);
+
+        const auto end = _Size + 1;
+        auto bestWeight = std::numeric_limits<TWeight>::min();
+        TSize bestLength = 0;
+        auto isKnownLetter = false;
+
+        _Words.ForEachMatch(_State,
+          [&](const TSize wordLength, const size_t)
+        {
+          const auto currentWeight = WeightAt(end - wordLength)
+            + TScoring::Known(NoPayload(), static_cast<TWeight>(wordLength));
+          if (bestWeight < currentWeight)
+          {
+            bestWeight = currentWeight;
+            bestLength = wordLength;
+          }
+
+          isKnownLetter = 1 == wordLength;
+        });
+
+        if (!isKnownLetter)
+        {
+          const auto currentWeight = WeightAt(_Size) + TScoring::Unknown(1);
+          if (bestWeight < currentWeight)
+          {
+            bestWeight = currentWeight;
+            bestLength = 1;
+          }
+        }
+
+        _Size = end;
+        _Weights.push_back(bestWeight);
+        if (static_cast<size_t>(_MaxLength) < _Weights.size())
+        {
+          _Weights.pop_front();
+        }
+
+        _Lengths.push_back(bestLength);
+      }
+
+      //The back pointers form a tree rooted at 0, where a parent is smaller.
+      //The answer is the lowest common ancestor of the positions
+      // [_Size + 1 - _MaxLength, _Size].
+      template <typename TSize, typename TWeight, typename TScoring>
+      TSize StreamingWordRecognizer<TSize, TWeight, TScoring>::FindAgreedPosition() const
+      {
+        if (_Size < _MaxLength + _Resolved)
+        {//The resolved position itself can still be extended.
+          return _Resolved;
+        }
+
+        const auto lowest = _Size + 1 - _MaxLength;
+
+        auto result = _Size;
+        for (auto position = _Size; lowest < position && _Resolved < result;)
+        {
+          --position;
+
+          auto other = position;
+          while (result != other)
+          {
+            if (other < result)
+            {
+              result -= LengthAt(result);
+            }
+            else
+            {
+              other -= LengthAt(other);
+            }
+          }
+        }
+
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TScoring>
+      template <typename TEmit>
+      void StreamingWordRecognizer<TSize, TWeight, TScoring>::EmitTill(
+        const TSize end, TEmit& emit)
+      {
+        _Chain.clear();
+        for (auto position = end; _Resolved < position;)
+        {
+          const auto length = LengthAt(position);
+          position -= length;
+          _Chain.push_back({ position, length });
+        }
+
+        for (auto it = _Chain.crbegin(); it != _Chain.crend(); ++it)
+        {
+          emit(*it);
+        }
+
+        _Lengths.erase(_Lengths.begin(), _Lengths.begin() + (end - _Resolved));
+        _Resolved = end;
+      }
+    }
+  }
+}
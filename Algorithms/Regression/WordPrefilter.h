@@ -0,0 +1,227 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //Built once per dictionary, it rejects most of the substrings,
+      // which are not words, without a dictionary lookup:
+      // - A bitmap of the word lengths, present in the dictionary.
+      // - A blocked Bloom filter of the word hashes:
+      //   all the bits of a word are in one 64-bit block, that is one memory read.
+      //
+      //The word hashes are polynomial modulo 2^64.
+      //Given the prefix hashes of a text, see HashText,
+      // the hash of any substring is O(1), whatever its length.
+      //A collision only costs an extra lookup, so that a weak hash is fine.
+      template <typename TSize = size_t>
+      class WordPrefilter final
+      {
+      public:
+
+        //Below 1% false positives with the default.
+        static constexpr size_t DefaultBitsPerWord = 12;
+
+        template <typename TWords>
+        explicit WordPrefilter(const TWords& words,
+          const size_t bitsPerWord = DefaultBitsPerWord);
+
+        inline TSize get_MaxLength() const
+        {
+          return _MaxLength;
+        }
+
+        //The word lengths, present in the dictionary, the longest first.
+        inline const std::vector<TSize>& get_Lengths() const
+        {
+          return _Lengths;
+        }
+
+        inline bool HasLength(const size_t length) const
+        {
+          const auto result = length <= static_cast<size_t>(_MaxLength)
+            && 0 != (_LengthBits[length / 64] & (std::uint64_t(1) << (length % 64)));
+          return result;
+        }
+
+        //Store the hashes of the "text" prefixes, "|text| + 1" of them.
+        void HashText(const std::string& text,
+          std::vector<std::uint64_t>& prefixes) const;
+
+        //Return false when the substring [offset, offset + length)
+        // of the text, hashed into the "prefixes", is certainly not a word.
+        inline bool MayContain(const std::vector<std::uint64_t>& prefixes,
+          const size_t offset,
+          const size_t length) const
+        {
+          if (!HasLength(length))
+          {
+            return false;
+          }
+
+          const auto hash = prefixes[offset + length] - prefixes[offset] * _Powers[length];
+          const auto result = MayContainHash(hash, length);
+          return result;
+        }
+
+      private:
+
+        static constexpr std::uint64_t Base = 0x100000001B3ull;
+        static constexpr int HashCount = 6;
+        static constexpr int BlockShift = 6 * HashCount;
+
+        std::vector<std::uint64_t> _LengthBits;
+        std::vector<TSize> _Lengths;
+        TSize _MaxLength;
+
+        //The "Base" powers, up to the longest word.
+        std::vector<std::uint64_t> _Powers;
+
+        std::vector<std::uint64_t> _Blocks;
+
+        static inline std::uint64_t Mix(std::uint64_t value)
+        {
+          value ^= value >> 30;
+          value *= 0xBF58476D1CE4E5B9ull;
+          value ^= value >> 27;
+          value *= 0x94D049BB133111EBull;
+          value ^= value >> 31;
+          return value;
+        }
+
+        static inline std::uint64_t Step(const std::uint64_t hash, const char letter)
+        {
+          return hash * Base + static_cast<unsigned char>(letter) + 1;
+        }
+
+        //The bit numbers are taken from the low 6 * HashCount = 36 bits,
+        // and the block index from the high 28 bits, so that they do not overlap.
+        inline std::pair<size_t, std::uint64_t> BlockAndBits(
+          const std::uint64_t hash, const size_t length) const
+        {
+          const auto mixed = Mix(hash + length * 0x9E3779B97F4A7C15ull);
+          const auto block = static_cast<size_t>(mixed >> BlockShift) & (_Blocks.size() - 1);
+
+          std::uint64_t bits = 0;
+          for (int index = 0; index < HashCount; ++index)
+          {
+            bits |= std::uint64_t(1) << ((mixed >> (6 * index)) & 63);
+          }
+
+          return{ block, bits };
+        }
+
+        inline bool MayContainHash(const std::uint64_t hash, const size_t length) const
+        {
+          const auto blockAndBits = BlockAndBits(hash, length);
+          const auto result = blockAndBits.second
+            == (_Blocks[blockAndBits.first] & blockAndBits.second);
+          return result;
+        }
+
+        static inline const std::string& WordOf(const std::string& word)
+        {
+          return word;
+        }
+
+        //A dictionary with a payload, e.g. std::unordered_map.
+        template <typename TPayload>
+        static inline const std::string& WordOf(const std::pair<const std::string, TPayload>& item)
+        {
+          return item.first;
+        }
+      };
+
+      template <typename TSize>
+      template <typename TWords>
+      WordPrefilter<TSize>::WordPrefilter(const TWords& words, const size_t bitsPerWord)
+        : _MaxLength(0)
+      {
+        size_t count = 0;
+        size_t maxLength = 0;
+        for (const auto& item : words)
+        {
+          maxLength = std::max(maxLength, WordOf(item).size());
+          ++count;
+        }
+
+        _MaxLength = static_cast<TSize>(maxLength);
+        if (static_cast<size_t>(_MaxLength) != maxLength)
+        {
+          std::ostringstream ss;
+          ss << "Too long words are not supported: "
+            << maxLength << " as TSize is " << _MaxLength
+            << ". Consider replacing TSize.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        _LengthBits.assign(maxLength / 64 + 1, 0);
+
+        _Powers.resize(maxLength + 1);
+        _Powers[0] = 1;
+        for (size_t length = 1; length <= maxLength; ++length)
+        {
+          _Powers[length] = _Powers[length - 1] * Base;
+        }
+
+        //A power of two, at most the high bits can address.
+        const auto bits = std::max(count * std::max(bitsPerWord, size_t(1)), size_t(64));
+        constexpr size_t maxBlockCount = size_t(1) << (64 - BlockShift);
+        size_t blockCount = 1;
+        while (blockCount * 64 < bits && blockCount < maxBlockCount)
+        {
+          blockCount <<= 1;
+        }
+
+        _Blocks.assign(blockCount, 0);
+
+        for (const auto& item : words)
+        {
+          const auto& word = WordOf(item);
+
+          std::uint64_t hash = 0;
+          for (const auto& letter : word)
+          {
+            hash = Step(hash, letter);
+          }
+
+          const auto blockAndBits = BlockAndBits(hash, word.size());
+          _Blocks[blockAndBits.first] |= blockAndBits.second;
+
+          _LengthBits[word.size() / 64] |= std::uint64_t(1) << (word.size() % 64);
+        }
+
+        for (auto length = maxLength; 0 < length; --length)
+        {
+          if (HasLength(length))
+          {
+            _Lengths.push_back(static_cast<TSize>(length));
+          }
+        }
+      }
+
+      template <typename TSize>
+      void WordPrefilter<TSize>::HashText(const std::string& text,
+        std::vector<std::uint64_t>& prefixes) const
+      {
+        prefixes.resize(text.size() + 1);
+        prefixes[0] = 0;
+
+        for (size_t index = 0; index < text.size(); ++index)
+        {
+          prefixes[index + 1] = Step(prefixes[index], text[index]);
+        }
+      }
+    }
+  }
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <limits>
 #include <ostream>
 #include <type_traits>
@@ -6,9 +7,15 @@
 #include <utility>
 #include <vector>
 
+#include "AhoCorasick.h"
+#include "DoubleArrayTrie.h"
 #include "WordPosition.h"
+#include "WordPrefilter.h"
+#include "WordScoring.h"
 #include "../StreamUtilities.h"
 #include "../ExceptionUtilities.h"
+#include "../ParallelUtilities.h"
+#include "../Utf8Utilities.h"
 
 namespace MyCompany
 {
@@ -19,7 +26,9 @@ namespace MyCompany
       template<typename TSize = size_t,
         //Must be unsigned.
         typename TWeight = long long,
-        typename TDictionary = std::unordered_set<std::string>
+        typename TDictionary = std::unordered_set<std::string>,
+        //See WordScoring.h.
+        typename TScoring = CubeScoring<TWeight>
       >
       class WordRecognizer final
       {
@@ -33,10 +42,19 @@ namespace MyCompany
         using WordPosition = WordPosition<TSize>;
         using CostAndPositions = std::pair<TWeight, std::vector<WordPosition>>;
 
+        //A word in the text, a dictionary one or not, with its weight.
+        struct LatticeEdge final
+        {
+          TSize Offset;
+          TSize Length;
+          TWeight Weight;
+        };
+
         //Given a text and a dictionary of words,
         //insert separators to maximize the total weight:
         // - If a word belongs to the dictionary, the cube of the word length is added.
         // - Else that is subtracted.
+        //The weights are given by the TScoring, the above is the default CubeScoring.
         //Return the total weight and words positions(offset and length).
         //
         //The running time is O(|text| * |longest word| * DictionarySearchTime)
@@ -47,112 +65,1441 @@ namespace MyCompany
           //If zero, then the "words" will be scanned to find the longest word.
           TSize maxLengthOfWord = {});
 
-        //The cube is being used to favor the longer words.
-        static constexpr inline TWeight EvaluateWeight(const TWeight size)
+        //The buffers, reused by the Recognize calls below; keep one per thread.
+        //They never shrink, so that once they fit the longest text,
+        // a call makes no heap allocations.
+        class Workspace final
+        {
+          friend class WordRecognizer;
+
+          std::pair<std::vector<TWeight>, std::vector<WordPosition>> _Matrices;
+
+          //The substring being looked up.
+          std::string _Word;
+
+        public:
+
+          //Grow the buffers for a text of the "size" letters in advance.
+          void Reserve(const size_t size)
+          {
+            _Matrices.first.reserve(size + 1);
+            _Matrices.second.reserve(size);
+          }
+        };
+
+        //The same as above, but the "workspace" and the "result" buffers are reused.
+        //Return the total weight; the words positions are written into the "result".
+        //
+        //There are no heap allocations once the buffers have grown to the text size,
+        // provided the "maxLengthOfWord" is given, and the "words" lookup does not allocate.
+        static TWeight Recognize(
+          const std::string& text,
+          const TDictionary& words,
+          //If zero, then the "words" will be scanned to find the longest word.
+          TSize maxLengthOfWord,
+          Workspace& workspace,
+          std::vector<WordPosition>& result);
+
+        //The same as above, but a substring is looked up in the "words"
+        // only when the "prefilter", built for them, has not rejected it.
+        //When the TScoring::IsUnknownSplittable,
+        // only the lengths, present in the "words", and the single letters are tried.
+        //
+        //The running time is O(|text| * |distinct word lengths|
+        // + number of candidates * DictionarySearchTime)
+        static CostAndPositions Recognize(
+          const std::string& text,
+          const TDictionary& words,
+          const WordPrefilter<TSize>& prefilter);
+
+        //Recognize each of the texts in [textsBegin, textsEnd) as above,
+        // using the threads of the "pool", which are kept between the calls.
+        //The longest word is found once for all the texts.
+        //The result[i] is for the textsBegin[i].
+        static std::vector<CostAndPositions> RecognizeBatch(
+          const std::string* textsBegin,
+          const std::string* textsEnd,
+          const TDictionary& words,
+          ParallelUtilities::ThreadPool& pool,
+          //If zero, then the "words" will be scanned to find the longest word.
+          TSize maxLengthOfWord = {});
+
+        //The same as above, but the threads are started for this call only.
+        static std::vector<CostAndPositions> RecognizeBatch(
+          const std::string* textsBegin,
+          const std::string* textsEnd,
+          const TDictionary& words,
+          //If zero, then the number of hardware threads.
+          size_t threadCount = {},
+          //If zero, then the "words" will be scanned to find the longest word.
+          TSize maxLengthOfWord = {});
+
+        //Return at most "count" best segmentations, the best first.
+        //The first one is the same as returned by the Recognize.
+        //The "count" is limited by the maximum value of the TSize.
+        //
+        //A DP cell keeps the "count" best weights in one flat array,
+        // each with the rank of the predecessor in its own cell.
+        //The running time is O(|text| * |longest word| * (DictionarySearchTime + count))
+        static std::vector<CostAndPositions> RecognizeBest(
+          const std::string& text,
+          const TDictionary& words,
+          const size_t count,
+          //If zero, then the "words" will be scanned to find the longest word.
+          TSize maxLengthOfWord = {});
+
+        //Return the dictionary words in the "text", and every single letter not being a word,
+        // sorted by the offset, then by the length.
+        //An unknown piece of several letters is skipped
+        // when the TScoring::IsUnknownSplittable.
+        static std::vector<LatticeEdge> BuildLattice(
+          const std::string& text,
+          const TDictionary& words,
+          //If zero, then the "words" will be scanned to find the longest word.
+          TSize maxLengthOfWord = {});
+
+        //The same as above, but the "words" have been compiled in advance.
+        //Each offset is walked forward once, and no substring is created.
+        //
+        //The running time is O(|text| * |longest word|)
+        // even when there are many long words.
+        static CostAndPositions Recognize(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words);
+
+        //The same as above, but the "workspace" and the "result" buffers are reused:
+        // there are no heap allocations once they have grown to the text size.
+        //Return the total weight.
+        static TWeight Recognize(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words,
+          Workspace& workspace,
+          std::vector<WordPosition>& result);
+
+        //The same as above, but a piece of the text also matches a word
+        // within the "maxDistance" edits (Levenshtein distance),
+        // then its weight is divided by "distance + 1".
+        //With the zero "maxDistance", the result is the same as above.
+        //
+        //For each offset, the trie is walked once together with a Levenshtein automaton
+        // of the text after the offset: the automaton state is the DP row
+        // of the distances from the trie path to the text prefixes.
+        //A branch is cut, once none of the distances is within the "maxDistance",
+        // so that only a small part of the trie is visited.
+        //
+        //The walk is still costly. When the "isNearUnknownOnly",
+        // the exact segmentation is found first, and an approximate word is tried
+        // only from the start of its piece, from which a word may reach an unknown letter.
+        //Elsewhere, only the exact words are taken: a text, mostly made of the words,
+        // is recognized close to the exact speed, but a typo, whose letters
+        // still split into the known words, is not corrected.
+        static CostAndPositions RecognizeApproximate(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words,
+          const size_t maxDistance,
+          const bool isNearUnknownOnly = false);
+
+        //The same as above, but all the word occurrences are found first
+        // by one scan of the automaton.
+        //Then only the actual words, and the single letters, are tried.
+        //
+        //The running time is O(|text| + number of word occurrences),
+        // which does not depend on the longest word length.
+        static CostAndPositions Recognize(
+          const std::string& text,
+          const AhoCorasick<TSize>& words);
+
+        //The same as above, but the "text" is split into chunks, processed in parallel.
+        //The result is the same.
+        //
+        //Each chunk is first solved in parallel, from a guessed boundary.
+        //Then the chunks are fixed in order, starting from the actual boundary.
+        //A step only looks back |longest word| positions,
+        // so once that many new weights differ from the guessed ones by the same constant,
+        // the rest of the chunk only has to be shifted by that constant:
+        // the best choices are the same.
+        //Typically this happens after a few words, so the fixing is cheap.
+        static CostAndPositions RecognizeParallel(
+          const std::string& text,
+          const AhoCorasick<TSize>& words,
+          //If zero, then the number of hardware threads.
+          size_t threadCount = {},
+          //If zero, then a default is used.
+          //It cannot be smaller than the longest word length.
+          size_t chunkSize = {});
+
+        //A word of a UTF-8 text, in bytes and in codepoints.
+        struct Utf8Position final
+        {
+          WordPosition Bytes;
+          WordPosition Codepoints;
+        };
+
+        using Utf8CostAndPositions = std::pair<TWeight, std::vector<Utf8Position>>;
+
+        //The same as the Recognize, but the "text" and the "words" are UTF-8.
+        //The text is validated, and its codepoint boundaries are indexed first;
+        // then only the splits on the boundaries are tried,
+        // so that a codepoint is never broken.
+        //The lengths, including the "maxLengthOfWord" and the weights, are in codepoints.
+        //
+        //The running time is O(|text| + |codepoints| * |longest word| * DictionarySearchTime)
+        static Utf8CostAndPositions RecognizeUtf8(
+          const std::string& text,
+          const TDictionary& words,
+          //If zero, then the "words" will be scanned to find the longest word.
+          TSize maxLengthOfWord = {});
+
+        //The cube is being used to favor the longer words.
+        static constexpr inline TWeight EvaluateWeight(const TWeight size)
+        {
+          return CubeScoring<TWeight>::Cube(size);
+        }
+
+        //The longest word length, e.g. to be computed once per dictionary
+        // and passed as the "maxLengthOfWord".
+        static TSize WordMaxLength(const TDictionary& words);
+
+      private:
+
+        using TMatrices = std::pair<std::vector<TWeight>, std::vector<WordPosition>>;
+
+        //Short texts are many, so that a thread of the RecognizeBatch takes several at once.
+        static constexpr size_t BatchBlockSize = 64;
+
+        //The text offsets must fit into the TSize.
+        static void CheckTextSize(const size_t textSize);
+
+        //Return the actual "maxLengthOfWord".
+        static TSize CheckMaxLength(
+          const TDictionary& words,
+          TSize maxLengthOfWord);
+
+        static TMatrices ComputeBestWeightsAndPositions(
+          const std::string& text,
+          const TDictionary& words,
+          const TSize maxLengthOfWord);
+
+        //The "workspace" is overwritten, reusing its memory.
+        static void ComputeBestWeightsAndPositions(
+          const std::string& text,
+          const TDictionary& words,
+          const TSize maxLengthOfWord,
+          Workspace& workspace);
+
+        static TMatrices ComputeBestWeightsAndPositions(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words);
+
+        //The "matrices" are overwritten, reusing their memory.
+        static void ComputeBestWeightsAndPositions(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words,
+          TMatrices& matrices);
+
+        //The first item has "end - begin + 2" begins into the second one.
+        //The word lengths, ending at "end", are stored in
+        // [begins[end - begin], begins[end - begin + 1]), the longest word first.
+        using TMatches = std::pair<std::vector<size_t>, std::vector<TSize>>;
+
+        //Find the words, ending in (begin, end], and starting from the "scanBegin".
+        static TMatches FindMatches(
+          const std::string& text,
+          const AhoCorasick<TSize>& words,
+          const size_t scanBegin,
+          const size_t begin,
+          const size_t end);
+
+        static TMatrices ComputeBestWeightsAndPositions(
+          const size_t textSize,
+          const TMatches& matches);
+
+        //The matches start at the "begin",
+        // and the "weights[0]" is for the position "shift".
+        static std::pair<TWeight, WordPosition> BestMatch(
+          const TMatches& matches,
+          const size_t begin,
+          const std::vector<TWeight>& weights,
+          const size_t shift,
+          const size_t end);
+
+        //The weights are for the positions [Shift, End];
+        // those till the Begin come from the previous chunk.
+        //After the Converged position, the weights are less by the Delta.
+        struct Chunk final
+        {
+          size_t Begin;
+          size_t End;
+          size_t Shift;
+          TMatches Matches;
+          std::vector<TWeight> Weights;
+          size_t Converged;
+          TWeight Delta;
+
+          inline TWeight WeightAt(const size_t position) const
+          {
+            const auto weight = Weights[position - Shift];
+            const auto result = Converged < position ? weight + Delta : weight;
+            return result;
+          }
+        };
+
+        static void ComputeChunk(
+          Chunk& chunk,
+          std::vector<WordPosition>& positions);
+
+        static void FixChunk(
+          const size_t maxLengthOfWord,
+          const Chunk& previous,
+          Chunk& chunk,
+          std::vector<WordPosition>& positions);
+
+        //The weights for a compiled dictionary, which only finds the words.
+        static inline TWeight KnownWeight(const TSize length)
+        {
+          static_assert(TScoring::IsUnknownSplittable,
+            "A compiled dictionary requires the TScoring, where an unknown piece"
+            " of several letters is worse than its single letters.");
+
+          return TScoring::Known(NoPayload(), static_cast<TWeight>(length));
+        }
+
+        static inline TWeight UnknownLetterWeight()
+        {
+          return TScoring::Unknown(1);
+        }
+
+        //Extend the best sequence ending at "offset" with the word [offset, offset + length).
+        static inline void Relax(
+          std::vector<TWeight>& weights,
+          std::vector<WordPosition>& positions,
+          const TSize offset, const TSize length,
+          const TWeight currentWeight)
+        {
+          const auto end = offset + length;
+          if (weights[end] < currentWeight)
+          {
+            weights[end] = currentWeight;
+            positions[end - 1] = { offset, length };
+          }
+        }
+
+        static void TrySuffix(
+          const std::string& text, const TDictionary& words,
+#ifdef _DEBUG
+          const TSize maxLengthOfWord,
+#endif
+          const TWeight initialSequenceWeight,
+          const TSize subLength, const TSize offset,
+          std::string& word,
+          TWeight& bestWeight,
+          WordPosition& bestPosition);
+
+        //The "word" is a buffer for the substrings.
+        static std::pair<TWeight, WordPosition> BestPrefix(
+          const std::string& text,
+          const TDictionary& words,
+          const TSize maxLengthOfWord,
+          const std::vector<TWeight>& weights,
+          const TSize subLength,
+          std::string& word);
+
+        //Mark the starts of the pieces of the exact segmentation, given by the "positions",
+        // from which a word of the "maxLength" may reach an unknown letter.
+        static void MarkApproximateOffsets(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words,
+          const std::vector<WordPosition>& positions,
+          const size_t maxLength,
+          std::vector<char>& isApproximate);
+
+        //The distances of the "text" prefixes to the trie path are in the "rows",
+        // one row of "|window| + 1" items per trie depth.
+        //The "distances[length]" is the least distance of a word to the text prefix
+        // of the "length", and it is more than the "maxDistance" if none.
+        static void FindApproximate(
+          const DoubleArrayTrie<TSize>& words,
+          const char* window,
+          const size_t windowSize,
+          const size_t maxDistance,
+          const typename DoubleArrayTrie<TSize>::TIndex state,
+          const size_t depth,
+          std::vector<size_t>& rows,
+          std::vector<size_t>& distances);
+
+        //One of the best sequences, ending at a position.
+        struct RankedWeight final
+        {
+          TWeight Weight;
+          TSize Length;
+          //In the cell of the "end - Length".
+          TSize PreviousRank;
+        };
+
+        //Insert into the sorted "cell" of the "capacity", unless it is full of better items.
+        //Return false when the "candidate" is too small to be inserted.
+        static bool InsertRanked(
+          RankedWeight* cell, TSize& cellSize,
+          const TSize capacity,
+          const RankedWeight& candidate);
+
+        static TWeight EvaluateWord(
+          const TDictionary& words, const std::string& word);
+
+        static TWeight EvaluateWord(
+          const TDictionary& words, const std::string& word, const TWeight size);
+
+        static CostAndPositions BacktraceResult(
+          const size_t textSize, const TMatrices& matrices);
+
+        static CostAndPositions BacktraceResult(
+          const TWeight cost, const std::vector<WordPosition>& positions);
+
+        //The "result" is overwritten, reusing its memory.
+        static void BacktraceResult(
+          const std::vector<WordPosition>& positions,
+          std::vector<WordPosition>& result);
+
+        static TSize Utf8WordMaxLength(const TDictionary& words);
+
+        //A dictionary, storing its longest word length, is not scanned.
+        template <typename TWords>
+        static inline auto LongestWordLength(const TWords& words, int)
+          -> decltype(static_cast<size_t>(words.get_MaxLength()))
+        {
+          return static_cast<size_t>(words.get_MaxLength());
+        }
+
+        template <typename TWords>
+        static size_t LongestWordLength(const TWords& words, long);
+
+        static inline const std::string& WordOf(const std::string& word)
+        {
+          return word;
+        }
+
+        //A dictionary with a payload, e.g. std::unordered_map.
+        template <typename TPayload>
+        static inline const std::string& WordOf(const std::pair<const std::string, TPayload>& item)
+        {
+          return item.first;
+        }
+      };
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Recognize(
+          const std::string& text,
+          const TDictionary& words,
+          TSize maxLengthOfWord)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        maxLengthOfWord = CheckMaxLength(words, maxLengthOfWord);
+
+        const auto matrices = ComputeBestWeightsAndPositions(
+          text, words, maxLengthOfWord);
+        const auto result = BacktraceResult(text.size(), matrices);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TWeight WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Recognize(
+        const std::string& text,
+        const TDictionary& words,
+        TSize maxLengthOfWord,
+        Workspace& workspace,
+        std::vector<WordPosition>& result)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        maxLengthOfWord = CheckMaxLength(words, maxLengthOfWord);
+
+        ComputeBestWeightsAndPositions(text, words, maxLengthOfWord, workspace);
+
+        const auto& matrices = workspace._Matrices;
+        BacktraceResult(matrices.second, result);
+        return matrices.first[text.size()];
+      }
+
+      //The offsets still go up for an end,
+      // so the ties are broken as in the BestPrefix.
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Recognize(
+          const std::string& text,
+          const TDictionary& words,
+          const WordPrefilter<TSize>& prefilter)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        std::vector<std::uint64_t> prefixes;
+        prefilter.HashText(text, prefixes);
+
+        const auto textSize = text.size();
+        const auto maxLengthOfWord = static_cast<size_t>(prefilter.get_MaxLength());
+
+        std::vector<TWeight> weights(textSize + 1);
+        std::vector<WordPosition> positions(textSize);
+
+        std::string word;
+        const auto tryWord = [&](const size_t end, const size_t length,
+          TWeight& bestWeight, bool& isKnown)
+        {
+          const auto offset = end - length;
+
+          auto wordWeight = TScoring::Unknown(static_cast<TWeight>(length));
+          isKnown = false;
+          if (prefilter.MayContain(prefixes, offset, length))
+          {
+            word.assign(text, offset, length);
+            const auto found = words.find(word);
+            if (words.end() != found)
+            {
+              wordWeight = TScoring::Known(found, static_cast<TWeight>(length));
+              isKnown = true;
+            }
+          }
+
+          const auto currentWeight = weights[offset] + wordWeight;
+          if (bestWeight < currentWeight)
+          {
+            bestWeight = currentWeight;
+            positions[end - 1] = { static_cast<TSize>(offset), static_cast<TSize>(length) };
+          }
+        };
+
+        for (size_t end = 1; end <= textSize; ++end)
+        {
+          auto bestWeight = std::numeric_limits<TWeight>::min();
+          auto isKnown = false;
+
+          if (TScoring::IsUnknownSplittable)
+          {
+            auto isKnownLetter = false;
+            for (const auto& length : prefilter.get_Lengths())
+            {
+              if (static_cast<size_t>(length) <= end)
+              {
+                tryWord(end, length, bestWeight, isKnown);
+                if (isKnown && 1 == length)
+                {
+                  isKnownLetter = true;
+                }
+              }
+            }
+
+            if (!isKnownLetter)
+            {
+              const auto currentWeight = weights[end - 1] + UnknownLetterWeight();
+              if (bestWeight < currentWeight)
+              {
+                bestWeight = currentWeight;
+                positions[end - 1] = { static_cast<TSize>(end - 1), TSize(1) };
+              }
+            }
+          }
+          else
+          {
+            for (auto length = std::min(end, maxLengthOfWord); 0 < length; --length)
+            {
+              tryWord(end, length, bestWeight, isKnown);
+            }
+          }
+
+          weights[end] = bestWeight;
+        }
+
+        const auto result = BacktraceResult(weights[textSize], positions);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      std::vector<typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions>
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::RecognizeBatch(
+          const std::string* textsBegin,
+          const std::string* textsEnd,
+          const TDictionary& words,
+          ParallelUtilities::ThreadPool& pool,
+          TSize maxLengthOfWord)
+      {
+        ThrowIfEmpty(words, "words");
+        for (auto text = textsBegin; text != textsEnd; ++text)
+        {
+          ThrowIfEmpty(*text, "text");
+        }
+
+        maxLengthOfWord = CheckMaxLength(words, maxLengthOfWord);
+
+        const auto size = static_cast<size_t>(textsEnd - textsBegin);
+
+        std::vector<CostAndPositions> result(size);
+        std::vector<Workspace> workspaces(pool.size());
+
+        pool.ParallelFor(size, BatchBlockSize,
+          [&](const size_t threadIndex, const size_t begin, const size_t end)
+        {
+          auto& workspace = workspaces[threadIndex];
+
+          for (auto index = begin; index < end; ++index)
+          {
+            const auto& text = textsBegin[index];
+            ComputeBestWeightsAndPositions(text, words, maxLengthOfWord, workspace);
+            result[index] = BacktraceResult(text.size(), workspace._Matrices);
+          }
+        });
+
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      std::vector<typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions>
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::RecognizeBatch(
+          const std::string* textsBegin,
+          const std::string* textsEnd,
+          const TDictionary& words,
+          const size_t threadCount,
+          const TSize maxLengthOfWord)
+      {
+        //There is no use in more threads than the blocks of the texts.
+        const auto blockCount = (static_cast<size_t>(textsEnd - textsBegin)
+          + BatchBlockSize - 1) / BatchBlockSize;
+
+        ParallelUtilities::ThreadPool pool(std::min(
+          ParallelUtilities::ThreadCount(threadCount), std::max(blockCount, size_t(1))));
+
+        const auto result = RecognizeBatch(textsBegin, textsEnd, words, pool, maxLengthOfWord);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CheckTextSize(const size_t textSize)
+      {
+        if (static_cast<size_t>(std::numeric_limits<TSize>::max()) < textSize)
+        {
+          std::ostringstream ss;
+          ss << "The text is too long, " << textSize
+            << " letters. Consider replacing TSize.";
+          StreamUtilities::ThrowException(ss);
+        }
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TSize WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CheckMaxLength(
+        const TDictionary& words,
+        TSize maxLengthOfWord)
+      {
+        if (0 == maxLengthOfWord)
+        {
+          maxLengthOfWord = WordMaxLength(words);
+        }
+#ifdef _DEBUG
+        else
+        {
+          const auto actualMaxLength = WordMaxLength(words);
+          if (actualMaxLength != maxLengthOfWord)
+          {
+            std::ostringstream ss;
+            ss << "Error: actualMaxLength (" << actualMaxLength
+              << ") != maxLengthOfWord(" << maxLengthOfWord << ").";
+            StreamUtilities::ThrowException(ss);
+          }
+        }
+#endif
+        return maxLengthOfWord;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Recognize(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        const auto matrices = ComputeBestWeightsAndPositions(text, words);
+        const auto result = BacktraceResult(text.size(), matrices);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TWeight WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Recognize(
+        const std::string& text,
+        const DoubleArrayTrie<TSize>& words,
+        Workspace& workspace,
+        std::vector<WordPosition>& result)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        auto& matrices = workspace._Matrices;
+        ComputeBestWeightsAndPositions(text, words, matrices);
+
+        BacktraceResult(matrices.second, result);
+        return matrices.first[text.size()];
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Recognize(
+          const std::string& text,
+          const AhoCorasick<TSize>& words)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        const auto matches = FindMatches(text, words, 0, 0, text.size());
+        const auto matrices = ComputeBestWeightsAndPositions(text.size(), matches);
+        const auto result = BacktraceResult(text.size(), matrices);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::TMatrices
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::ComputeBestWeightsAndPositions(
+          const std::string& text,
+          const TDictionary& words,
+          const TSize maxLengthOfWord)
+      {
+        Workspace workspace;
+        ComputeBestWeightsAndPositions(text, words, maxLengthOfWord, workspace);
+        return std::move(workspace._Matrices);
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::ComputeBestWeightsAndPositions(
+        const std::string& text,
+        const TDictionary& words,
+        const TSize maxLengthOfWord,
+        Workspace& workspace)
+      {
+        const auto textSize = text.size();
+
+        std::vector<TWeight>& weights = workspace._Matrices.first;
+        std::vector<WordPosition>& positions = workspace._Matrices.second;
+
+        //Each item is written before being read.
+        weights.resize(textSize + 1);
+        positions.resize(textSize);
+        weights[0] = {};
+
+        for (TSize subLength = 0; subLength < textSize; ++subLength)
+        {
+          const auto best = BestPrefix(
+            text, words, maxLengthOfWord, weights, subLength, workspace._Word);
+
+          weights[subLength + 1] = best.first;
+          positions[subLength] = best.second;
+        }
+      }
+
+      //Go forward: once the "weights[offset]" is final,
+      // every word starting at the "offset" extends it.
+      //For the same end, the smaller offsets still come first,
+      // so the ties are broken exactly as in the suffix search.
+      //
+      //An unknown piece of several letters is never the best,
+      // see the TScoring::IsUnknownSplittable.
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::TMatrices
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::ComputeBestWeightsAndPositions(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words)
+      {
+        TMatrices result;
+        ComputeBestWeightsAndPositions(text, words, result);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::ComputeBestWeightsAndPositions(
+        const std::string& text,
+        const DoubleArrayTrie<TSize>& words,
+        TMatrices& matrices)
+      {
+        CheckTextSize(text.size());
+        const auto textSize = static_cast<TSize>(text.size());
+        const auto textEnd = text.data() + text.size();
+
+        std::vector<TWeight>& weights = matrices.first;
+        std::vector<WordPosition>& positions = matrices.second;
+
+        weights.assign(textSize + 1, std::numeric_limits<TWeight>::min());
+        positions.resize(textSize);
+        weights[0] = {};
+
+        for (TSize offset = 0; offset < textSize; ++offset)
+        {
+          const auto initialSequenceWeight = weights[offset];
+          auto isKnownLetter = false;
+
+          words.ForEachPrefix(text.data() + offset, textEnd,
+            [&](const TSize wordLength, const size_t)
+          {
+            if (1 == wordLength)
+            {
+              isKnownLetter = true;
+            }
+            else
+            {
+              Relax(weights, positions, offset, wordLength,
+                initialSequenceWeight + KnownWeight(wordLength));
+            }
+          });
+
+          Relax(weights, positions, offset, 1, initialSequenceWeight
+            + (isKnownLetter ? KnownWeight(1) : UnknownLetterWeight()));
+        }
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::RecognizeApproximate(
+          const std::string& text,
+          const DoubleArrayTrie<TSize>& words,
+          const size_t maxDistance,
+          const bool isNearUnknownOnly)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        const auto textSize = text.size();
+        const auto maxWordLength = static_cast<size_t>(words.get_MaxLength());
+        const auto maxLength = maxWordLength + maxDistance;
+
+        TMatrices matrices;
+        std::vector<char> isApproximate;
+        if (0 == maxDistance || isNearUnknownOnly)
+        {
+          ComputeBestWeightsAndPositions(text, words, matrices);
+          if (0 == maxDistance)
+          {
+            const auto result = BacktraceResult(textSize, matrices);
+            return result;
+          }
+
+          MarkApproximateOffsets(text, words, matrices.second, maxLength, isApproximate);
+        }
+        else
+        {
+          isApproximate.assign(textSize, true);
+        }
+
+        std::vector<TWeight>& weights = matrices.first;
+        std::vector<WordPosition>& positions = matrices.second;
+
+        weights.assign(textSize + 1, std::numeric_limits<TWeight>::min());
+        positions.resize(textSize);
+        weights[0] = {};
+
+        std::vector<size_t> rows;
+        std::vector<size_t> distances;
+
+        for (size_t offset = 0; offset < textSize; ++offset)
+        {
+          size_t windowSize;
+          if (isApproximate[offset])
+          {
+            windowSize = std::min(maxLength, textSize - offset);
+
+            rows.resize((maxWordLength + 1) * (windowSize + 1));
+            for (size_t length = 0; length <= windowSize; ++length)
+            {
+              rows[length] = std::min(length, maxDistance + 1);
+            }
+
+            distances.assign(windowSize + 1, maxDistance + 1);
+            FindApproximate(words, text.data() + offset, windowSize, maxDistance,
+              DoubleArrayTrie<TSize>::RootState, 0, rows, distances);
+          }
+          else
+          {
+            windowSize = std::min(maxWordLength, textSize - offset);
+            distances.assign(windowSize + 1, maxDistance + 1);
+
+            words.ForEachPrefix(text.data() + offset, text.data() + offset + windowSize,
+              [&](const TSize wordLength, const size_t)
+            {
+              distances[wordLength] = 0;
+            });
+          }
+
+          const auto initialSequenceWeight = weights[offset];
+          for (size_t length = 1; length <= windowSize; ++length)
+          {
+            const auto distance = distances[length];
+            if (maxDistance < distance)
+            {
+              if (1 == length)
+              {
+                Relax(weights, positions, static_cast<TSize>(offset), 1,
+                  initialSequenceWeight + UnknownLetterWeight());
+              }
+
+              continue;
+            }
+
+            const auto wordWeight = KnownWeight(static_cast<TSize>(length))
+              / static_cast<TWeight>(distance + 1);
+
+            Relax(weights, positions, static_cast<TSize>(offset), static_cast<TSize>(length),
+              initialSequenceWeight + wordWeight);
+          }
+        }
+
+        const auto result = BacktraceResult(weights[textSize], positions);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::MarkApproximateOffsets(
+        const std::string& text,
+        const DoubleArrayTrie<TSize>& words,
+        const std::vector<WordPosition>& positions,
+        const size_t maxLength,
+        std::vector<char>& isApproximate)
+      {
+        isApproximate.assign(text.size(), false);
+
+        //Go back by the pieces, remembering the nearest unknown letter after them.
+        auto nextUnknown = std::numeric_limits<size_t>::max();
+        for (auto end = positions.size(); 0 < end;)
+        {
+          const auto& position = positions[end - 1];
+          const auto offset = static_cast<size_t>(position.get_Offset());
+          end = offset;
+
+          if (1 == position.get_Length()
+            && DoubleArrayTrie<TSize>::NotFound == words.find(text.data() + offset, 1))
+          {
+            nextUnknown = offset;
+          }
+
+          if (nextUnknown - offset < maxLength)
+          {
+            isApproximate[offset] = true;
+          }
+        }
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::FindApproximate(
+        const DoubleArrayTrie<TSize>& words,
+        const char* window,
+        const size_t windowSize,
+        const size_t maxDistance,
+        const typename DoubleArrayTrie<TSize>::TIndex state,
+        const size_t depth,
+        std::vector<size_t>& rows,
+        std::vector<size_t>& distances)
+      {
+        const auto rowSize = windowSize + 1;
+
+        words.ForEachChild(state, [&](const char letter,
+          const typename DoubleArrayTrie<TSize>::TIndex child)
+        {
+          const auto previous = rows.begin() + depth * rowSize;
+          const auto current = previous + rowSize;
+
+          //Only the band [childDepth - maxDistance, childDepth + maxDistance]
+          // may be within the "maxDistance"; the items around it are set to "tooFar",
+          // which is enough as any larger distance is as bad.
+          const auto childDepth = depth + 1;
+          const auto tooFar = maxDistance + 1;
+          const auto first = maxDistance < childDepth ? childDepth - maxDistance : size_t(1);
+          const auto last = std::min(windowSize, childDepth + maxDistance);
+
+          current[first - 1] = 1 == first ? std::min(childDepth, tooFar) : tooFar;
+          auto minDistance = current[first - 1];
+
+          for (size_t length = first; length <= last; ++length)
+          {
+            const auto replaced = previous[length - 1]
+              + (letter == window[length - 1] ? 0 : 1);
+
+            current[length] = std::min(replaced,
+              std::min(previous[length], current[length - 1]) + 1);
+
+            minDistance = std::min(minDistance, current[length]);
+          }
+
+          if (last < windowSize)
+          {
+            current[last + 1] = tooFar;
+          }
+
+          if (maxDistance < minDistance)
+          {
+            return;
+          }
+
+          if (DoubleArrayTrie<TSize>::NotFound != words.WordId(child))
+          {
+            for (size_t length = first; length <= last; ++length)
+            {
+              distances[length] = std::min(distances[length], current[length]);
+            }
+          }
+
+          FindApproximate(words, window, windowSize, maxDistance,
+            child, depth + 1, rows, distances);
+        });
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::TMatches
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::FindMatches(
+          const std::string& text,
+          const AhoCorasick<TSize>& words,
+          const size_t scanBegin,
+          const size_t begin,
+          const size_t end)
+      {
+        const auto size = end - begin;
+        const auto skip = begin - scanBegin;
+
+        std::vector<size_t> begins(size + 2);
+        std::vector<TSize> lengths;
+
+        words.Scan(text.data() + scanBegin, text.data() + end,
+          [&](const TSize wordEnd, const TSize length, const size_t)
+        {
+          if (skip < wordEnd)
+          {
+            lengths.push_back(length);
+            ++begins[wordEnd - skip + 1];
+          }
+        });
+
+        for (size_t index = 1; index <= size + 1; ++index)
+        {
+          begins[index] += begins[index - 1];
+        }
+
+        return{ begins, lengths };
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::TMatrices
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::ComputeBestWeightsAndPositions(
+          const size_t textSize,
+          const TMatches& matches)
+      {
+        std::vector<TWeight> weights(textSize + 1);
+        std::vector<WordPosition> positions(textSize);
+
+        for (size_t end = 1; end <= textSize; ++end)
         {
-          return size * size * size;
+          const auto best = BestMatch(matches, 0, weights, 0, end);
+
+          weights[end] = best.first;
+          positions[end - 1] = best.second;
         }
 
-      private:
+        return{ weights, positions };
+      }
 
-        using TMatrices = std::pair<std::vector<TWeight>, std::vector<WordPosition>>;
+      //Since the matches are the longest first, they are tried
+      // from the smallest offset, as in the suffix search.
+      //An unknown piece of several letters is never the best,
+      // so only an unknown single letter is tried.
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      std::pair<TWeight, typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::WordPosition>
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::BestMatch(
+          const TMatches& matches,
+          const size_t begin,
+          const std::vector<TWeight>& weights,
+          const size_t shift,
+          const size_t end)
+      {
+        const auto& begins = matches.first;
+        const auto& lengths = matches.second;
 
-        static TMatrices ComputeBestWeightsAndPositions(
-          const std::string& text,
-          const TDictionary& words,
-          const TSize maxLengthOfWord);
+        TWeight bestWeight = std::numeric_limits<TWeight>::min();
+        WordPosition bestPosition{};
+        auto isKnownLetter = false;
 
-        static void TrySuffix(
-          const std::string& text, const TDictionary& words,
-#ifdef _DEBUG
-          const TSize maxLengthOfWord,
-#endif
-          const TWeight initialSequenceWeight,
-          const TSize subLength, const TSize offset,
-          TWeight& bestWeight,
-          WordPosition& bestPosition);
+        const auto index = end - begin;
+        for (auto match = begins[index]; match < begins[index + 1]; ++match)
+        {
+          const auto wordLength = lengths[match];
+          const auto offset = end - wordLength;
 
-        static std::pair<TWeight, WordPosition> BestPrefix(
+          const auto currentWeight = weights[offset - shift] + KnownWeight(wordLength);
+          if (bestWeight < currentWeight)
+          {
+            bestWeight = currentWeight;
+            bestPosition = { static_cast<TSize>(offset), wordLength };
+          }
+
+          isKnownLetter = 1 == wordLength;
+        }
+
+        if (!isKnownLetter)
+        {
+          const auto offset = end - 1;
+          const auto currentWeight = weights[offset - shift] + UnknownLetterWeight();
+          if (bestWeight < currentWeight)
+          {
+            bestWeight = currentWeight;
+            bestPosition = { static_cast<TSize>(offset), 1 };
+          }
+        }
+
+        return{ bestWeight, bestPosition };
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::RecognizeParallel(
           const std::string& text,
-          const TDictionary& words,
-          const TSize maxLengthOfWord,
-          const std::vector<TWeight>& weights,
-          const TSize subLength);
+          const AhoCorasick<TSize>& words,
+          size_t threadCount,
+          size_t chunkSize)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
 
-        static TWeight EvaluateWord(
-          const TDictionary& words, const std::string& word);
+        const auto textSize = text.size();
+        const auto maxLengthOfWord = static_cast<size_t>(words.get_MaxLength());
 
-        static CostAndPositions BacktraceResult(
-          const size_t textSize, const TMatrices& matrices);
+        if (0 == chunkSize)
+        {
+          constexpr size_t defaultChunkSize = 1 << 20;
+          chunkSize = defaultChunkSize;
+        }
 
-        static TSize WordMaxLength(const TDictionary& words);
-      };
+        //A chunk must cover the whole boundary window of the next one.
+        chunkSize = std::max(chunkSize, maxLengthOfWord);
+
+        const auto chunkCount = std::max(textSize / chunkSize, size_t(1));
+
+        std::vector<Chunk> chunks(chunkCount);
+        std::vector<WordPosition> positions(textSize);
+
+        ParallelUtilities::ParallelFor(chunkCount, threadCount, 1,
+          [&](const size_t, const size_t first, const size_t last)
+        {
+          for (auto index = first; index < last; ++index)
+          {
+            auto& chunk = chunks[index];
+            chunk.Begin = index * chunkSize;
+            chunk.End = chunkCount == index + 1 ? textSize : chunk.Begin + chunkSize;
+            chunk.Shift = 0 == index ? 0 : chunk.Begin + 1 - maxLengthOfWord;
+            chunk.Matches = FindMatches(text, words, chunk.Shift, chunk.Begin, chunk.End);
+
+            //Except for the first chunk, the boundary is a guess.
+            chunk.Weights.assign(chunk.End + 1 - chunk.Shift, TWeight());
+            chunk.Converged = chunk.End;
+            chunk.Delta = {};
+
+            ComputeChunk(chunk, positions);
+          }
+        });
+
+        for (size_t index = 1; index < chunkCount; ++index)
+        {
+          FixChunk(maxLengthOfWord, chunks[index - 1], chunks[index], positions);
+        }
+
+        const auto cost = chunks.back().WeightAt(textSize);
+        const auto result = BacktraceResult(cost, positions);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::ComputeChunk(
+        Chunk& chunk,
+        std::vector<WordPosition>& positions)
+      {
+        for (auto end = chunk.Begin + 1; end <= chunk.End; ++end)
+        {
+          const auto best = BestMatch(
+            chunk.Matches, chunk.Begin, chunk.Weights, chunk.Shift, end);
+
+          chunk.Weights[end - chunk.Shift] = best.first;
+          positions[end - 1] = best.second;
+        }
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::FixChunk(
+        const size_t maxLengthOfWord,
+        const Chunk& previous,
+        Chunk& chunk,
+        std::vector<WordPosition>& positions)
+      {
+        for (auto position = chunk.Shift; position <= chunk.Begin; ++position)
+        {
+          chunk.Weights[position - chunk.Shift] = previous.WeightAt(position);
+        }
+
+        size_t sameDeltaCount = 0;
+        TWeight delta{};
+
+        for (auto end = chunk.Begin + 1; end <= chunk.End; ++end)
+        {
+          const auto best = BestMatch(
+            chunk.Matches, chunk.Begin, chunk.Weights, chunk.Shift, end);
+
+          auto& weight = chunk.Weights[end - chunk.Shift];
+          const TWeight currentDelta = best.first - weight;
+          if (0 < sameDeltaCount && delta == currentDelta)
+          {
+            ++sameDeltaCount;
+          }
+          else
+          {
+            delta = currentDelta;
+            sameDeltaCount = 1;
+          }
+
+          weight = best.first;
+          positions[end - 1] = best.second;
+
+          if (maxLengthOfWord <= sameDeltaCount)
+          {
+            chunk.Converged = end;
+            chunk.Delta = delta;
+            return;
+          }
+        }
+      }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      typename WordRecognizer<TSize, TWeight, TDictionary>::CostAndPositions
-        WordRecognizer<TSize, TWeight, TDictionary>::Recognize(
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      std::vector<typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions>
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::RecognizeBest(
           const std::string& text,
           const TDictionary& words,
+          const size_t count,
           TSize maxLengthOfWord)
       {
         ThrowIfEmpty(text, "text");
         ThrowIfEmpty(words, "words");
+        if (0 == count)
+        {
+          throw std::runtime_error("The count must be positive.");
+        }
 
-        if (0 == maxLengthOfWord)
+        maxLengthOfWord = CheckMaxLength(words, maxLengthOfWord);
+
+        const auto textSize = text.size();
+        //A rank is stored as TSize: a larger "count" is clamped rather than truncated.
+        const auto capacity = static_cast<TSize>(std::min<size_t>(count,
+          static_cast<size_t>(std::numeric_limits<TSize>::max())));
+
+        //The cell "end" is [cells[end * capacity], cells[end * capacity + sizes[end]]).
+        std::vector<RankedWeight> cells((textSize + 1) * capacity);
+        std::vector<TSize> sizes(textSize + 1);
+
+        cells[0] = { TWeight(), 0, 0 };
+        sizes[0] = 1;
+
+        std::string word;
+
+        for (size_t end = 1; end <= textSize; ++end)
         {
-          maxLengthOfWord = WordMaxLength(words);
+          auto cell = cells.data() + end * capacity;
+          auto& cellSize = sizes[end];
+
+          //Skip too long words.
+          const auto initialOffset = end <= maxLengthOfWord ? 0 : end - maxLengthOfWord;
+
+          for (auto offset = initialOffset; offset < end; ++offset)
+          {
+            const auto wordLength = static_cast<TSize>(end - offset);
+
+            //The capacity is reused, so there is no allocation.
+            word.assign(text, offset, wordLength);
+            const auto wordWeight = EvaluateWord(words, word);
+
+            const auto previousCell = cells.data() + offset * capacity;
+            for (TSize rank = 0; rank < sizes[offset]; ++rank)
+            {
+              const RankedWeight candidate{ previousCell[rank].Weight + wordWeight, wordLength, rank };
+              if (!InsertRanked(cell, cellSize, capacity, candidate))
+              {//The next ranks are not better.
+                break;
+              }
+            }
+          }
         }
-#ifdef _DEBUG
-        else
+
+        const auto resultCount = sizes[textSize];
+        std::vector<CostAndPositions> result(resultCount);
+
+        for (TSize rank = 0; rank < resultCount; ++rank)
         {
-          const auto actualMaxLength = WordMaxLength(words);
-          if (actualMaxLength != maxLengthOfWord)
+          auto& positions = result[rank].second;
+          result[rank].first = cells[textSize * capacity + rank].Weight;
+
+          auto currentRank = rank;
+          for (auto end = textSize; 0 < end;)
           {
-            std::ostringstream ss;
-            ss << "Error: actualMaxLength (" << actualMaxLength
-              << ") != maxLengthOfWord(" << maxLengthOfWord << ").";
-            StreamUtilities::ThrowException(ss);
+            const auto& ranked = cells[end * capacity + currentRank];
+            end -= ranked.Length;
+
+            positions.push_back({ static_cast<TSize>(end), ranked.Length });
+            currentRank = ranked.PreviousRank;
           }
+
+          std::reverse(positions.begin(), positions.end());
         }
-#endif
-        const auto matrices = ComputeBestWeightsAndPositions(
-          text, words, maxLengthOfWord);
-        const auto result = BacktraceResult(text.size(), matrices);
+
         return result;
       }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      typename WordRecognizer<TSize, TWeight, TDictionary>::TMatrices
-        WordRecognizer<TSize, TWeight, TDictionary>::ComputeBestWeightsAndPositions(
+      //The equal weights keep their order, so that the first found one wins,
+      // as in the Recognize.
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      bool WordRecognizer<TSize, TWeight, TDictionary, TScoring>::InsertRanked(
+        RankedWeight* cell, TSize& cellSize,
+        const TSize capacity,
+        const RankedWeight& candidate)
+      {
+        if (capacity == cellSize)
+        {
+          if (candidate.Weight <= cell[cellSize - 1].Weight)
+          {
+            return false;
+          }
+
+          --cellSize;
+        }
+
+        auto index = cellSize;
+        while (0 < index && cell[index - 1].Weight < candidate.Weight)
+        {
+          cell[index] = cell[index - 1];
+          --index;
+        }
+
+        cell[index] = candidate;
+        ++cellSize;
+        return true;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      std::vector<typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::LatticeEdge>
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::BuildLattice(
           const std::string& text,
           const TDictionary& words,
-          const TSize maxLengthOfWord)
+          TSize maxLengthOfWord)
       {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        maxLengthOfWord = CheckMaxLength(words, maxLengthOfWord);
+
         const auto textSize = text.size();
 
-        std::vector<TWeight> weights(textSize + 1);
-        std::vector<WordPosition> positions(textSize);
+        std::vector<LatticeEdge> result;
+        //At least each letter.
+        result.reserve(textSize);
 
-        for (TSize subLength = 0; subLength < textSize; ++subLength)
+        std::string word;
+
+        for (size_t offset = 0; offset < textSize; ++offset)
         {
-          const auto best = BestPrefix(
-            text, words, maxLengthOfWord, weights, subLength);
+          const auto maxLength = std::min(static_cast<size_t>(maxLengthOfWord), textSize - offset);
 
-          weights[subLength + 1] = best.first;
-          positions[subLength] = best.second;
+          for (size_t wordLength = 1; wordLength <= maxLength; ++wordLength)
+          {
+            word.assign(text, offset, wordLength);
+
+            const auto found = words.find(word);
+            const auto isKnown = words.end() != found;
+            if (isKnown || 1 == wordLength || !TScoring::IsUnknownSplittable)
+            {
+              const auto wordWeight = isKnown
+                ? TScoring::Known(found, static_cast<TWeight>(wordLength))
+                : TScoring::Unknown(static_cast<TWeight>(wordLength));
+
+              result.push_back({ static_cast<TSize>(offset),
+                static_cast<TSize>(wordLength), wordWeight });
+            }
+          }
         }
 
-        return{ weights, positions };
+        return result;
+      }
+
+      //The same as the ComputeBestWeightsAndPositions, but over the codepoints:
+      // the "offset" and the "end" are codepoint indexes.
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Utf8CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::RecognizeUtf8(
+          const std::string& text,
+          const TDictionary& words,
+          TSize maxLengthOfWord)
+      {
+        ThrowIfEmpty(text, "text");
+        ThrowIfEmpty(words, "words");
+
+        if (0 == maxLengthOfWord)
+        {
+          maxLengthOfWord = Utf8WordMaxLength(words);
+        }
+
+        std::vector<TSize> boundaries;
+        Utf8Utilities::IndexBoundaries(text.data(), text.size(), boundaries);
+
+        const auto count = static_cast<TSize>(boundaries.size() - 1);
+
+        std::vector<TWeight> weights(count + 1);
+        std::vector<WordPosition> positions(count);
+
+        std::string word;
+        for (TSize end = 1; end <= count; ++end)
+        {
+          auto bestWeight = std::numeric_limits<TWeight>::min();
+
+          const TSize initialOffset = end <= maxLengthOfWord ? 0 : end - maxLengthOfWord;
+          for (auto offset = initialOffset; offset < end; ++offset)
+          {
+            word.assign(text, boundaries[offset], boundaries[end] - boundaries[offset]);
+
+            const auto currentWeight = weights[offset]
+              + EvaluateWord(words, word, static_cast<TWeight>(end - offset));
+            if (bestWeight < currentWeight)
+            {
+              bestWeight = currentWeight;
+              positions[end - 1] = { offset, static_cast<TSize>(end - offset) };
+            }
+          }
+
+          weights[end] = bestWeight;
+        }
+
+        const auto codepoints = BacktraceResult(weights[count], positions);
+
+        Utf8CostAndPositions result;
+        result.first = codepoints.first;
+        result.second.reserve(codepoints.second.size());
+
+        for (const auto& position : codepoints.second)
+        {
+          const auto begin = boundaries[position.get_Offset()];
+          const auto end = boundaries[position.get_Offset() + position.get_Length()];
+          result.second.push_back({ { begin, static_cast<TSize>(end - begin) }, position });
+        }
+
+        return result;
       }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      std::pair<TWeight, typename WordRecognizer<TSize, TWeight, TDictionary>::WordPosition>
-        WordRecognizer<TSize, TWeight, TDictionary>::BestPrefix(
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      std::pair<TWeight, typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::WordPosition>
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::BestPrefix(
           const std::string& text,
           const TDictionary& words,
           const TSize maxLengthOfWord,
           const std::vector<TWeight>& weights,
-          const TSize subLength)
+          const TSize subLength,
+          std::string& word)
       {
         TWeight bestWeight = std::numeric_limits<TWeight>::min();
 
@@ -176,6 +1523,7 @@ namespace MyCompany
 #endif
             initialSequenceWeight,
             subLength, offset,
+            word,
             bestWeight, bestPosition);
         }
 
@@ -188,14 +1536,15 @@ namespace MyCompany
         return{ bestWeight,bestPosition };
       }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      void WordRecognizer<TSize, TWeight, TDictionary>::TrySuffix(
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::TrySuffix(
         const std::string& text, const TDictionary& words,
 #ifdef _DEBUG
         const TSize maxLengthOfWord,
 #endif
         const TWeight initialSequenceWeight,
         const TSize subLength, const TSize offset,
+        std::string& word,
         TWeight& bestWeight, WordPosition& bestPosition)
       {
         const TSize wordLength = subLength + 1 - offset;
@@ -211,9 +1560,8 @@ namespace MyCompany
           StreamUtilities::ThrowException(ss);
         }
 #endif
-        //TODO: p3. Do not create a new string.
-        const auto suffix = text.substr(offset, wordLength);
-        const auto wordWeight = EvaluateWord(words, suffix);
+        word.assign(text, offset, wordLength);
+        const auto wordWeight = EvaluateWord(words, word);
 
         const TWeight currentWeight = initialSequenceWeight + wordWeight;
         if (bestWeight < currentWeight)
@@ -223,9 +1571,9 @@ namespace MyCompany
         }
       }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      typename WordRecognizer<TSize, TWeight, TDictionary>::CostAndPositions
-        WordRecognizer<TSize, TWeight, TDictionary>::BacktraceResult(
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::BacktraceResult(
           const size_t textSize, const TMatrices& matrices)
       {
         const std::vector<TWeight>& weights = matrices.first;
@@ -233,63 +1581,104 @@ namespace MyCompany
 
         const TWeight cost = weights[textSize];
 
-        std::vector<WordPosition> resultPositions;
+        const auto result = BacktraceResult(cost, positions);
+        return result;
+      }
 
-        for (auto index = textSize - 1;;)
-        {
-          resultPositions.push_back(positions[index]);
-          if (0 == positions[index].get_Offset())
-          {
-            break;
-          }
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      typename WordRecognizer<TSize, TWeight, TDictionary, TScoring>::CostAndPositions
+        WordRecognizer<TSize, TWeight, TDictionary, TScoring>::BacktraceResult(
+          const TWeight cost, const std::vector<WordPosition>& positions)
+      {
+        CostAndPositions result;
+        result.first = cost;
+        BacktraceResult(positions, result.second);
+        return result;
+      }
 
-          const auto lengthToSubtract = positions[index].get_Length();
+      //The words are counted first, and then written from the end,
+      // so that the "result" neither grows step by step nor is reversed.
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      void WordRecognizer<TSize, TWeight, TDictionary, TScoring>::BacktraceResult(
+        const std::vector<WordPosition>& positions,
+        std::vector<WordPosition>& result)
+      {
+        size_t count = 0;
+        for (auto index = positions.size(); 0 < index;)
+        {
+          const auto lengthToSubtract = positions[index - 1].get_Length();
 #ifdef _DEBUG
-          if (index < lengthToSubtract)
+          if (index < lengthToSubtract || 0 == lengthToSubtract)
           {
             std::ostringstream ss;
             ss << "index(" << index << ") < " << lengthToSubtract
-              << " == positions[" << index << "].get_Length().";
+              << " == positions[" << (index - 1) << "].get_Length().";
             StreamUtilities::ThrowException(ss);
           }
 #endif
           index -= lengthToSubtract;
-        };
-
-        std::reverse(resultPositions.begin(), resultPositions.end());
+          ++count;
+        }
 
-        return{ cost, resultPositions };
+        result.resize(count);
+        for (auto index = positions.size(); 0 < index;)
+        {
+          const auto& position = positions[index - 1];
+          result[--count] = position;
+          index -= position.get_Length();
+        }
       }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      TWeight WordRecognizer<TSize, TWeight, TDictionary>::EvaluateWord(
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TWeight WordRecognizer<TSize, TWeight, TDictionary, TScoring>::EvaluateWord(
         const TDictionary& words, const std::string& word)
       {
-        const auto size = word.size();
-        const auto weight = EvaluateWeight(static_cast<TWeight>(size));
+        const auto size = static_cast<TWeight>(word.size());
 
+        const auto result = EvaluateWord(words, word, size);
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TWeight WordRecognizer<TSize, TWeight, TDictionary, TScoring>::EvaluateWord(
+        const TDictionary& words, const std::string& word, const TWeight size)
+      {
         const auto found = words.find(word);
 
         const auto result = words.end() == found
-          ? -weight : weight;
+          ? TScoring::Unknown(size)
+          : TScoring::Known(found, size);
         return result;
       }
 
-      template <typename TSize, typename TWeight, typename TDictionary>
-      TSize WordRecognizer<TSize, TWeight, TDictionary>::WordMaxLength(
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TSize WordRecognizer<TSize, TWeight, TDictionary, TScoring>::WordMaxLength(
         const TDictionary& words)
       {
-        size_t resultLong = 0;
+        const size_t resultLong = LongestWordLength(words, 0);
 
-        for (const std::string& word : words)
+        const auto result = static_cast<TSize>(resultLong);
+        const auto resultTemp = static_cast<size_t>(result);
+        if (result != resultTemp)
         {
-          const size_t wordLength = word.size();
-#ifdef _DEBUG
-          if (0 == wordLength)
-          {
-            throw std::runtime_error("0 == wordLength");
-          }
-#endif
+          std::ostringstream ss;
+          ss << "Too long words are not supported: "
+            << resultLong << " as TSize is " << result
+            << ". Consider replacing TSize.";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        return result;
+      }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      TSize WordRecognizer<TSize, TWeight, TDictionary, TScoring>::Utf8WordMaxLength(
+        const TDictionary& words)
+      {
+        size_t resultLong = 0;
+        for (const auto& item : words)
+        {
+          const auto wordLength = Utf8Utilities::CodepointCount(WordOf(item));
           if (resultLong < wordLength)
           {
             resultLong = wordLength;
@@ -297,8 +1686,7 @@ namespace MyCompany
         }
 
         const auto result = static_cast<TSize>(resultLong);
-        const auto resultTemp = static_cast<size_t>(result);
-        if (result != resultTemp)
+        if (static_cast<size_t>(result) != resultLong)
         {
           std::ostringstream ss;
           ss << "Too long words are not supported: "
@@ -309,6 +1697,31 @@ namespace MyCompany
 
         return result;
       }
+
+      template <typename TSize, typename TWeight, typename TDictionary, typename TScoring>
+      template <typename TWords>
+      size_t WordRecognizer<TSize, TWeight, TDictionary, TScoring>::LongestWordLength(
+        const TWords& words, long)
+      {
+        size_t resultLong = 0;
+
+        for (const auto& item : words)
+        {
+          const size_t wordLength = WordOf(item).size();
+#ifdef _DEBUG
+          if (0 == wordLength)
+          {
+            throw std::runtime_error("0 == wordLength");
+          }
+#endif
+          if (resultLong < wordLength)
+          {
+            resultLong = wordLength;
+          }
+        }
+
+        return resultLong;
+      }
     }
   }
 }
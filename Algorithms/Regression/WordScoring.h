@@ -0,0 +1,98 @@
+#pragma once
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Regression
+    {
+      //The scoring policies of the WordRecognizer, resolved at compile time.
+      //A policy has:
+      // - "Known(found, length)" - the weight of a dictionary word,
+      //   where the "found" is the dictionary iterator,
+      //   or NoPayload when the dictionary is compiled, e.g. a DoubleArrayTrie.
+      // - "Unknown(length)" - the weight of a piece, not in the dictionary.
+      // - "IsUnknownSplittable" - whether an unknown piece of several letters
+      //   is always worse than its single letters.
+      //   Then only the single letters need to be tried,
+      //   which is required by the compiled dictionaries.
+
+      //Passed instead of a dictionary iterator when there is no payload.
+      struct NoPayload final
+      {
+      };
+
+      //The cube of the length is added for a known word, and subtracted otherwise.
+      //The cube is being used to favor the longer words.
+      template <typename TWeight>
+      struct CubeScoring final
+      {
+        static constexpr bool IsUnknownSplittable = true;
+
+        static constexpr inline TWeight Cube(const TWeight length)
+        {
+          return length * length * length;
+        }
+
+        template <typename TFound>
+        static constexpr inline TWeight Known(const TFound&, const TWeight length)
+        {
+          return Cube(length);
+        }
+
+        static constexpr inline TWeight Unknown(const TWeight length)
+        {
+          return -Cube(length);
+        }
+      };
+
+      //An unknown piece costs "Base + PerLetter * length".
+      //For a positive "Base", a long unknown piece is better than its letters.
+      template <typename TWeight,
+        long long PerLetter = 1,
+        long long Base = 0>
+      struct LengthPenaltyScoring final
+      {
+        static_assert(0 <= PerLetter && 0 <= Base,
+          "The penalty must not be negative.");
+
+        static constexpr bool IsUnknownSplittable = false;
+
+        template <typename TFound>
+        static constexpr inline TWeight Known(const TFound&, const TWeight length)
+        {
+          return CubeScoring<TWeight>::Cube(length);
+        }
+
+        static constexpr inline TWeight Unknown(const TWeight length)
+        {
+          return -(static_cast<TWeight>(Base) + static_cast<TWeight>(PerLetter) * length);
+        }
+      };
+
+      //The dictionary maps a word to its weight, e.g. a frequency or a log-probability:
+      // std::unordered_map<std::string, TWeight>.
+      //The unknown pieces are scored by the "TUnknownScoring".
+      template <typename TWeight,
+        typename TUnknownScoring = LengthPenaltyScoring<TWeight>>
+      struct PayloadScoring final
+      {
+        static constexpr bool IsUnknownSplittable = TUnknownScoring::IsUnknownSplittable;
+
+        template <typename TFound>
+        static inline TWeight Known(const TFound& found, const TWeight)
+        {
+          return static_cast<TWeight>(found->second);
+        }
+
+        //A compiled dictionary has no payload.
+        static TWeight Known(const NoPayload&, const TWeight) = delete;
+
+        static constexpr inline TWeight Unknown(const TWeight length)
+        {
+          return TUnknownScoring::Unknown(length);
+        }
+      };
+    }
+  }
+}
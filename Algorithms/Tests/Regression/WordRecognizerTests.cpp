@@ -1,11 +1,190 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include "../../Tests/TestUtilities.h"
+#include "../TemporaryFile.h"
 #include "../../PrintUtilities.h"
+#include "..\..\Regression\BigramRecognizer.h"
+#include "..\..\Regression\DictionaryHolder.h"
+#include "..\..\Regression\IncrementalWordRecognizer.h"
+#include "..\..\Regression\MappedDictionary.h"
+#include "..\..\Regression\StreamingWordRecognizer.h"
 #include "..\..\Regression\WordRecognizer.h"
 #include "WordRecognizerTests.h"
 
 using namespace std;
 using namespace MyCompany::Algorithms::Regression;
 using namespace MyCompany::Algorithms;
+using MyCompany::Algorithms::Tests::TemporaryFile;
+
+namespace
+{
+  //The heap allocations, made by this process, so that the reuse of a buffer is checked.
+  atomic<size_t> AllocationCount{};
+
+  void* TryAllocate(const size_t size) noexcept
+  {
+    ++AllocationCount;
+    return malloc(0 == size ? 1 : size);
+  }
+
+  void* Allocate(const size_t size)
+  {
+    const auto result = TryAllocate(size);
+    if (nullptr == result)
+    {
+      throw bad_alloc();
+    }
+
+    return result;
+  }
+
+#ifdef __cpp_aligned_new
+  void* TryAllocateAligned(const size_t size, const align_val_t alignment) noexcept
+  {
+    ++AllocationCount;
+
+    const auto bytes = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    return _aligned_malloc(0 == size ? 1 : size, bytes);
+#else
+    //The size must be a positive multiple of the alignment.
+    return aligned_alloc(bytes, (max(size, size_t(1)) + bytes - 1) / bytes * bytes);
+#endif
+  }
+
+  void* AllocateAligned(const size_t size, const align_val_t alignment)
+  {
+    const auto result = TryAllocateAligned(size, alignment);
+    if (nullptr == result)
+    {
+      throw bad_alloc();
+    }
+
+    return result;
+  }
+
+  void FreeAligned(void* pointer) noexcept
+  {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+  }
+#endif
+}
+
+//The whole set is replaced, so that a sanitizer sees no mismatch
+// between an allocation by the library and a deallocation here.
+void* operator new(size_t size)
+{
+  return Allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+  return Allocate(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+  return TryAllocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+  return TryAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete(void* pointer, const nothrow_t&) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void* pointer, const nothrow_t&) noexcept
+{
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, align_val_t alignment)
+{
+  return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+  return AllocateAligned(size, alignment);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+  return TryAllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+  return TryAllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer, align_val_t) noexcept
+{
+  FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, align_val_t) noexcept
+{
+  FreeAligned(pointer);
+}
+
+void operator delete(void* pointer, align_val_t, const nothrow_t&) noexcept
+{
+  FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, align_val_t, const nothrow_t&) noexcept
+{
+  FreeAligned(pointer);
+}
+
+void operator delete(void* pointer, size_t, align_val_t) noexcept
+{
+  FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, size_t, align_val_t) noexcept
+{
+  FreeAligned(pointer);
+}
+#endif
 
 namespace
 {
@@ -208,15 +387,779 @@ namespace
     }
   }
 
+  void CheckResult(const TestCase& testCase,
+    const TWordRecognizer::CostAndPositions& costPositions,
+    const string& name)
+  {
+    Assert::AreEqual(testCase.ExpectedCost, costPositions.first, "Cost_" + name);
+    Assert::AreEqual(testCase.ExpectedPositions, costPositions.second, "Positions_" + name);
+  }
+
+  void RunBest(const TestCase& testCase)
+  {
+    constexpr size_t count = 5;
+    const auto best = TWordRecognizer::RecognizeBest(testCase.Text, testCase.Words, count);
+    Assert::NotEmpty(best, "Best");
+    Assert::GreaterOrEqual(count, best.size(), "Best size");
+    CheckResult(testCase, best[0], "Best_0");
+
+    for (size_t rank = 1; rank < best.size(); ++rank)
+    {
+      const auto name = "Best_" + to_string(rank);
+      Assert::GreaterOrEqual(best[rank - 1].first, best[rank].first, name);
+
+      TWeight cost{};
+      TSize offset{};
+      for (const auto& position : best[rank].second)
+      {
+        Assert::AreEqual(offset, position.get_Offset(), name + " offset");
+        offset += position.get_Length();
+
+        const auto word = testCase.Text.substr(position.get_Offset(), position.get_Length());
+        const auto weight = TWordRecognizer::EvaluateWeight(position.get_Length());
+        cost += testCase.Words.count(word) ? weight : -weight;
+      }
+
+      Assert::AreEqual(testCase.Text.size(), static_cast<size_t>(offset), name + " end");
+      Assert::AreEqual(best[rank].first, cost, name + " cost");
+    }
+
+    const auto lattice = TWordRecognizer::BuildLattice(testCase.Text, testCase.Words);
+    for (const auto& position : testCase.ExpectedPositions)
+    {
+      const auto found = find_if(lattice.cbegin(), lattice.cend(),
+        [&](const TWordRecognizer::LatticeEdge& edge)
+      {
+        return edge.Offset == position.get_Offset() && edge.Length == position.get_Length();
+      });
+      Assert::AreEqual(true, lattice.cend() != found, "Lattice edge");
+    }
+  }
+
+  //The "count" above the TSize maximum is clamped, not truncated.
+  void BestNarrowSizeTest()
+  {
+    using TNarrowRecognizer = WordRecognizer<unsigned char, TWeight, TDictionary>;
+
+    //The "a" and "aa" make Fibonacci(15) == 610 segmentations.
+    const string text(14, 'a');
+    const TDictionary words{ "a", "aa" };
+
+    constexpr size_t count = 1000;
+    const auto best = TNarrowRecognizer::RecognizeBest(text, words, count);
+    Assert::AreEqual(size_t(numeric_limits<unsigned char>::max()), best.size(), "BestNarrow size");
+
+    //A text, longer than the TSize maximum, is not truncated.
+    const DoubleArrayTrie<unsigned char> trie(words);
+    const string longText(256, 'a');
+    Assert::ExpectException<runtime_error>(
+      [&](void) -> void { TNarrowRecognizer::Recognize(longText, trie); },
+      "The text is too long, 256 letters. Consider replacing TSize.", "BestNarrow trie long text");
+
+    const auto maxText = longText.substr(1);
+    Assert::AreEqual(TWeight(255 / 2 * 8 + 1),
+      TNarrowRecognizer::Recognize(maxText, trie).first, "BestNarrow trie max text");
+  }
+
+  void RunStreaming(const TestCase& testCase, const AhoCorasick<TSize>& automaton)
+  {
+    using TStreaming = StreamingWordRecognizer<TSize, TWeight>;
+
+    const auto& text = testCase.Text;
+    TStreaming recognizer(automaton);
+
+    for (size_t chunkSize = 1; chunkSize <= text.size(); ++chunkSize)
+    {
+      TWordRecognizer::CostAndPositions costPositions;
+      const auto emit = [&](const TWordPosition& position)
+      {
+        costPositions.second.push_back(position);
+      };
+
+      for (size_t offset = 0; offset < text.size(); offset += chunkSize)
+      {
+        const auto size = min(chunkSize, text.size() - offset);
+        recognizer.Append(text.data() + offset, size, emit);
+      }
+
+      costPositions.first = recognizer.Finish(emit);
+      CheckResult(testCase, costPositions, "Streaming_" + to_string(chunkSize));
+    }
+
+    //The buffer sizes of 1, a prime, and more than the text.
+    for (const size_t bufferSize : { size_t(1), size_t(7), text.size() + 1 })
+    {
+      istringstream input(text);
+      TWordRecognizer::CostAndPositions costPositions;
+      costPositions.first = TStreaming::Recognize(input, automaton,
+        [&](const TWordPosition& position)
+      {
+        costPositions.second.push_back(position);
+      }, bufferSize);
+
+      CheckResult(testCase, costPositions, "Streaming_stream_" + to_string(bufferSize));
+    }
+  }
+
+  void RunIncremental(const TestCase& testCase, const DoubleArrayTrie<TSize>& trie)
+  {
+    using TIncremental = IncrementalWordRecognizer<TSize, TWeight>;
+
+    const auto& text = testCase.Text;
+    TIncremental recognizer(trie, text);
+    CheckResult(testCase, { recognizer.get_Weight(), recognizer.get_Positions() }, "Incremental");
+
+    //Every edited state must be the same as a fresh recognition of the current text.
+    auto current = text;
+    const auto edit = [&](const size_t offset, const size_t length,
+      const string& replacement, const string& name)
+    {
+      recognizer.Replace(offset, length, replacement);
+      current.replace(offset, length, replacement);
+      Assert::AreEqual(current, recognizer.get_Text(), name + " text");
+
+      const auto expected = current.empty()
+        ? TWordRecognizer::CostAndPositions()
+        : TWordRecognizer::Recognize(current, trie);
+      Assert::AreEqual(expected.first, recognizer.get_Weight(), "Cost_" + name);
+      Assert::AreEqual(expected.second, recognizer.get_Positions(), "Positions_" + name);
+    };
+
+    //Break each letter, and restore it.
+    for (size_t offset = 0; offset < text.size(); ++offset)
+    {
+      const auto name = "Incremental_replace_" + to_string(offset);
+      edit(offset, 1, "#", name + "_broken");
+      edit(offset, 1, text.substr(offset, 1), name);
+    }
+
+    //At the beginning and at the end.
+    edit(0, 0, text.substr(0, 1), "Incremental_insert_first");
+    edit(0, 1, "", "Incremental_delete_first");
+    const auto tail = text.substr(0, 2);
+    edit(current.size(), 0, tail, "Incremental_insert_last");
+    edit(current.size() - tail.size(), tail.size(), "", "Incremental_delete_last");
+
+    //Remove a half, and insert it back.
+    const auto half = text.size() / 2;
+    edit(0, half, "", "Incremental_delete_half");
+    edit(0, 0, text.substr(0, half), "Incremental_insert_half");
+
+    //The whole text.
+    edit(0, current.size(), "", "Incremental_delete_all");
+    edit(0, 0, text, "Incremental_insert_all");
+    CheckResult(testCase, { recognizer.get_Weight(), recognizer.get_Positions() }, "Incremental_final");
+  }
+
+  void PayloadScoringTest()
+  {
+    using TPayloadDictionary = unordered_map<string, TWeight>;
+    using TPayloadRecognizer = WordRecognizer<TSize, TWeight,
+      TPayloadDictionary, PayloadScoring<TWeight>>;
+
+    //the youth event == 10 + 5 + 8 == 23 == not best.
+    //they outh event == 20 + 1 + 8 == 29
+    const TPayloadDictionary words{
+      { "the", 10 },{ "they", 20 },{ "youth", 5 },
+      { "outh", 1 },{ "event", 8 },{ "vent", 1 } };
+
+    const auto actual = TPayloadRecognizer::Recognize("theyouthevent", words);
+    Assert::AreEqual(TWeight(29), actual.first, "Payload cost");
+
+    const vector<TWordPosition> expectedPositions{ { 0, 4 },{ 4, 4 },{ 8, 5 } };
+    Assert::AreEqual(expectedPositions, actual.second, "Payload positions");
+  }
+
+  void LengthPenaltyScoringTest()
+  {
+    constexpr long long perLetter = 1, base = 5;
+    using TPenalty = LengthPenaltyScoring<TWeight, perLetter, base>;
+    using TPenaltyRecognizer = WordRecognizer<TSize, TWeight, TDictionary, TPenalty>;
+
+    //A long unknown piece is cheaper than its letters: (5 + 3) < (5 + 1) * 3.
+    const auto actual = TPenaltyRecognizer::Recognize("xyzthe", { "the" });
+
+    const auto expectedCost = TWordRecognizer::EvaluateWeight(3) - (base + 3 * perLetter);
+    Assert::AreEqual(expectedCost, actual.first, "Penalty cost");
+
+    const vector<TWordPosition> expectedPositions{ { 0, 3 },{ 3, 3 } };
+    Assert::AreEqual(expectedPositions, actual.second, "Penalty positions");
+  }
+
+  void Utf8Test()
+  {
+    //"日本語" - 3 codepoints of 3 bytes.
+    const string text = "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E";
+    const TDictionary words{ "\xE6\x97\xA5\xE6\x9C\xAC" };
+
+    const auto actual = TWordRecognizer::RecognizeUtf8(text, words);
+    Assert::AreEqual(TWeight(8 - 1), actual.first, "Utf8 cost");
+    Assert::AreEqual(size_t(2), actual.second.size(), "Utf8 size");
+
+    const vector<TWordPosition> expectedBytes{ { 0, 6 },{ 6, 3 } };
+    const vector<TWordPosition> expectedCodepoints{ { 0, 2 },{ 2, 1 } };
+    for (size_t index = 0; index < expectedBytes.size(); ++index)
+    {
+      Assert::AreEqual(expectedBytes[index], actual.second[index].Bytes, "Utf8 bytes");
+      Assert::AreEqual(expectedCodepoints[index], actual.second[index].Codepoints, "Utf8 codepoints");
+    }
+
+    //A lead byte without its continuation.
+    Assert::ExpectException<runtime_error>(
+      [&](void) -> void { TWordRecognizer::RecognizeUtf8("ab\xC3(", words); },
+      "Invalid UTF-8 codepoint at the byte 2.", "Utf8 invalid");
+  }
+
+  //The texts are longer than a SIMD block, so that a codepoint may cross the blocks.
+  void Utf8BoundariesTest()
+  {
+    string text;
+    for (size_t index = 0; index < 40; ++index)
+    {
+      text += "\xE6\x97\xA5";
+    }
+
+    text += "a";
+
+    vector<TSize> expected;
+    for (TSize offset = 0; offset <= 40 * 3; offset += 3)
+    {
+      expected.push_back(offset);
+    }
+
+    expected.push_back(40 * 3 + 1);
+
+    vector<TSize> boundaries;
+    Utf8Utilities::IndexBoundaries(text.data(), text.size(), boundaries);
+    Assert::AreEqual(expected, boundaries, "Utf8 boundaries");
+
+    //The text and the byte of the invalid codepoint.
+    const vector<pair<string, size_t>> invalidTexts{
+      //A lead byte at a block end, then an ASCII block.
+      { string(15, 'a') + "\xE6" + string(16, 'a'), 15 },
+      { string(14, 'a') + "\xE6\x97" + string(16, 'a'), 14 },
+      //A surrogate.
+      { string(20, 'a') + "\xED\xA0\x80" + string(10, 'a'), 20 },
+      //Above U+10FFFF.
+      { string(30, 'a') + "\xF4\x90\x80\x80" + string(10, 'a'), 30 },
+      //An overlong form.
+      { string(17, 'a') + "\xC0\xAF" + string(16, 'a'), 17 },
+      //A continuation without a lead byte.
+      { string(33, 'a') + "\x80" + string(16, 'a'), 33 },
+      //A continuation after a complete codepoint, in the block and at the next block start.
+      { string(3, 'a') + "\xC3\xA9\x80" + string(20, 'a'), 5 },
+      { string(14, 'a') + "\xC3\xA9\x80" + string(20, 'a'), 16 },
+      //A codepoint, cut by the end.
+      { string(31, 'a') + "\xF0\x9F\x98", 31 },
+    };
+
+    for (const auto& invalid : invalidTexts)
+    {
+      const auto& invalidText = invalid.first;
+      Assert::ExpectException<runtime_error>(
+        [&](void) -> void { Utf8Utilities::IndexBoundaries(invalidText.data(), invalidText.size(), boundaries); },
+        "Invalid UTF-8 codepoint at the byte " + to_string(invalid.second) + ".",
+        "Utf8 invalid " + to_string(invalid.second));
+    }
+  }
+
+  void ScoringTests()
+  {
+    PayloadScoringTest();
+    LengthPenaltyScoringTest();
+  }
+
+  void Utf8Tests()
+  {
+    Utf8Test();
+    Utf8BoundariesTest();
+  }
+
+  void ApproximateTest()
+  {
+    const DoubleArrayTrie<TSize> trie(TDictionary{ "hello", "world" });
+    const string text = "helloworlf";
+
+    //The "worlf" is 1 edit away from the "world": 125 + 125 / 2 == 187.
+    const auto actual = TWordRecognizer::RecognizeApproximate(text, trie, 1);
+    Assert::AreEqual(TWeight(187), actual.first, "Approximate cost");
+
+    const vector<TWordPosition> expectedPositions{ { 0, 5 },{ 5, 5 } };
+    Assert::AreEqual(expectedPositions, actual.second, "Approximate positions");
+
+    //Without edits, there are 5 unknown letters.
+    const auto exact = TWordRecognizer::RecognizeApproximate(text, trie, 0);
+    Assert::AreEqual(TWeight(125 - 5), exact.first, "Approximate exact cost");
+
+    const auto nearUnknown = TWordRecognizer::RecognizeApproximate(text, trie, 1, true);
+    Assert::AreEqual(TWeight(187), nearUnknown.first, "Approximate near unknown cost");
+    Assert::AreEqual(expectedPositions, nearUnknown.second, "Approximate near unknown positions");
+
+    //The typo "anple" splits into the known letters, so that there is no unknown one.
+    const DoubleArrayTrie<TSize> letters(TDictionary{ "a", "n", "p", "l", "e", "apple" });
+    const string typo = "anple";
+
+    //The "apple" is 1 edit away: 125 / 2 == 62.
+    const auto corrected = TWordRecognizer::RecognizeApproximate(typo, letters, 1);
+    Assert::AreEqual(TWeight(62), corrected.first, "Approximate typo of known letters cost");
+
+    const vector<TWordPosition> expectedCorrected{ { 0, 5 } };
+    Assert::AreEqual(expectedCorrected, corrected.second, "Approximate typo of known letters positions");
+
+    //Only the 5 known letters are taken.
+    const auto uncorrected = TWordRecognizer::RecognizeApproximate(typo, letters, 1, true);
+    Assert::AreEqual(TWeight(5), uncorrected.first, "Approximate typo near unknown cost");
+  }
+
+  //Many words, sharing prefixes, so that the bases collide:
+  // the build must stay fast, and every word must be found by its rank.
+  vector<string> GenerateWords(const size_t wordCount)
+  {
+    vector<string> result;
+    result.reserve(wordCount);
+
+    unsigned long long state = 12345;
+    for (size_t index = 0; index < wordCount; ++index)
+    {
+      string word;
+      do
+      {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const auto value = static_cast<unsigned>(state >> 33);
+        //Mostly the lowercase letters, sometimes a high byte of the UTF-8.
+        word += 0 == value % 37
+          ? static_cast<char>(0x80 + value % 64)
+          : static_cast<char>('a' + value % 26);
+      } while (word.size() < 12 && 0 != (state >> 60) % 4);
+
+      result.push_back(word);
+    }
+
+    return result;
+  }
+
+  void LargeTrieTest()
+  {
+    auto words = GenerateWords(200 * 1000);
+    const DoubleArrayTrie<TSize> trie(words);
+
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    Assert::AreEqual(words.size(), trie.size(), "Large trie size");
+
+    //A copy, as the Assert takes a reference, which needs a definition of the member.
+    const auto notFound = DoubleArrayTrie<TSize>::NotFound;
+
+    for (size_t index = 0; index < words.size(); ++index)
+    {
+      const auto& word = words[index];
+      const auto id = trie.find(word.c_str(), word.size());
+      if (index != id)
+      {
+        Assert::AreEqual(index, id, "Large trie word '" + word + "'");
+      }
+
+      //The "{" is never generated.
+      const auto longer = word + '{';
+      Assert::AreEqual(notFound,
+        trie.find(longer.c_str(), longer.size()), "Large trie not a word");
+    }
+  }
+
+  double TrieBuildSeconds(const vector<string>& words)
+  {
+    const auto started = chrono::steady_clock::now();
+    const DoubleArrayTrie<TSize> trie(words);
+    const auto result = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return result;
+  }
+
+  //Once the array is dense, a quadratic build would take 16 times longer
+  // for 4 times more words; a linear one - about 4 times.
+  void LargeTrieBuildTimeTest()
+  {
+    const auto words = GenerateWords(800 * 1000);
+    const vector<string> quarter(words.begin(), words.begin() + words.size() / 4);
+
+    const auto quarterSeconds = TrieBuildSeconds(quarter);
+    const auto seconds = TrieBuildSeconds(words);
+
+    const auto ratio = seconds / max(quarterSeconds, 1e-3);
+    if (12 < ratio)
+    {
+      Assert::AreEqual(quarterSeconds * 4, seconds, "Large trie build time");
+    }
+  }
+
+  //The uint64 at the "position" of the file is replaced by the "value".
+  void CorruptDictionary(const string& sourcePath, const string& path,
+    const size_t position, const uint64_t value)
+  {
+    string bytes;
+    {
+      ifstream source(sourcePath, ios::binary);
+      bytes.assign(istreambuf_iterator<char>(source), istreambuf_iterator<char>());
+    }
+
+    memcpy(&bytes[position], &value, sizeof value);
+
+    ofstream output(path, ios::binary | ios::trunc);
+    output.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+  }
+
+  //The counts and offsets in the file are not trusted.
+  void MappedDictionaryCorruptTest()
+  {
+    const TemporaryFile file("WordRecognizerTests.valid.dictionary");
+    const TemporaryFile corrupt("WordRecognizerTests.corrupt.dictionary");
+
+    //The histogram of 5 + 1, the displacements of 2 / 4 + 1, the slots of 2 + 2 / 4 + 1.
+    MappedDictionary::Write(file.get_Path(), TDictionary{ "hello", "world" });
+    constexpr size_t headerSize = 7 * 8;
+    constexpr size_t maxLengthPosition = 3 * 8;
+    constexpr size_t slotsPosition = headerSize + 6 * 8 + 8;
+    constexpr size_t offsetsPosition = slotsPosition + 8 + 8;
+
+    const MappedDictionary valid(file.get_Path());
+    Assert::AreEqual(string("world"), valid.word(1), "Mapped valid word");
+
+    const vector<pair<size_t, uint64_t>> corruptions{
+      //The "MaxLength + 1" overflows.
+      { maxLengthPosition, numeric_limits<uint64_t>::max() },
+      //A slot beyond the words.
+      { slotsPosition, 3 },
+      //The offsets decrease.
+      { offsetsPosition + 8, 11 },
+      //An empty word.
+      { offsetsPosition + 8, 0 },
+      //Beyond the letters.
+      { offsetsPosition + 16, 1000 * 1000 },
+    };
+
+    for (const auto& corruption : corruptions)
+    {
+      CorruptDictionary(file.get_Path(), corrupt.get_Path(), corruption.first, corruption.second);
+
+      const auto name = "Mapped corrupt at " + to_string(corruption.first);
+      const auto size = to_string(headerSize + 6 * 8 + 8 + 16 + 3 * 8 + 10);
+      Assert::ExpectException<runtime_error>(
+        [&](void) -> void { MappedDictionary(corrupt.get_Path()); },
+        "The file '" + corrupt.get_Path() + "' is not a valid dictionary, size=" + size + ".",
+        name);
+    }
+  }
+
+  void DictionaryHolderTest()
+  {
+    using THolder = DictionaryHolder<TDictionary, TSize>;
+
+    //hello world == 125 + 125 == 250.
+    //hell oworld == 64 + 216 == 280.
+    const string text = "helloworld";
+    const TDictionary oldWords{ "hello", "world" };
+    const TDictionary newWords{ "hell", "oworld" };
+    const auto oldCost = TWeight(250), newCost = TWeight(280);
+
+    const auto recognize = [&text](const THolder::Pin& pin) -> TWeight
+    {
+      const auto result = TWordRecognizer::Recognize(text, pin->Words, pin->MaxLengthOfWord);
+      return result.first;
+    };
+
+    THolder holder(oldWords, TWordRecognizer::WordMaxLength(oldWords));
+    {
+      const auto oldPin = holder.Acquire();
+      holder.Publish(newWords, TWordRecognizer::WordMaxLength(newWords));
+      Assert::AreEqual(size_t(1), holder.Reclaim(), "Holder pinned retired count");
+
+      Assert::AreEqual(oldCost, recognize(oldPin), "Holder old snapshot");
+      Assert::AreEqual(newCost, recognize(holder.Acquire()), "Holder new snapshot");
+    }
+    Assert::AreEqual(size_t(0), holder.Reclaim(), "Holder retired count");
+
+    //The readers must see either version while the writer swaps them.
+    constexpr size_t readerCount = 3, iterations = 300;
+    vector<size_t> mismatches(readerCount);
+    vector<thread> readers;
+    for (size_t reader = 0; reader < readerCount; ++reader)
+    {
+      readers.emplace_back([&, reader]()
+      {
+        for (size_t iteration = 0; iteration < iterations; ++iteration)
+        {
+          const auto cost = recognize(holder.Acquire());
+          mismatches[reader] += oldCost == cost || newCost == cost ? 0 : 1;
+        }
+      });
+    }
+
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+      const auto& words = 0 == iteration % 2 ? oldWords : newWords;
+      holder.Publish(words, TWordRecognizer::WordMaxLength(words));
+    }
+
+    for (auto& reader : readers)
+    {
+      reader.join();
+    }
+
+    Assert::AreEqual(vector<size_t>(readerCount), mismatches, "Holder mismatches");
+    Assert::AreEqual(size_t(0), holder.Reclaim(), "Holder final retired count");
+  }
+
+  using TBigramRecognizer = BigramRecognizer<TSize, TWeight>;
+  using TBigramModel = TBigramRecognizer::Model;
+
+  //Without bigrams, the beam of 1 is the unigram DP.
+  void RunBigram(const TestCase& testCase)
+  {
+    vector<TBigramModel::Unigram> unigrams;
+    for (const auto& word : testCase.Words)
+    {
+      const auto weight = TWordRecognizer::EvaluateWeight(static_cast<TWeight>(word.size()));
+      unigrams.push_back({ word, weight, 0 });
+    }
+
+    const TBigramModel model(unigrams, {}, -1);
+    const auto costPositions = TBigramRecognizer::Recognize(testCase.Text, model, 1);
+    Assert::AreEqual(testCase.ExpectedCost, costPositions.first, "Cost_Bigram");
+  }
+
+  void BigramTest()
+  {
+    //no where == -3 - 4 == -7 is the best by the unigrams.
+    //now here == -4 - 1 == -5
+    const TBigramModel model(
+      { { "no", -3, -2 },{ "now", -4, -2 },{ "where", -4, 0 },{ "here", -4, 0 } },
+      { { "now", "here", -1 } },
+      -10);
+
+    const string text = "nowhere";
+    const auto actual = TBigramRecognizer::Recognize(text, model);
+    Assert::AreEqual(TWeight(-5), actual.first, "Bigram cost");
+
+    const vector<TWordPosition> expectedPositions{ { 0, 3 },{ 3, 4 } };
+    Assert::AreEqual(expectedPositions, actual.second, "Bigram positions");
+
+    const TBigramModel unigramModel(
+      { { "no", -3, -2 },{ "now", -4, -2 },{ "where", -4, 0 },{ "here", -4, 0 } },
+      {},
+      -10);
+
+    //The backoff of "no" is added: -3 + (-2 - 4) == -9 > -4 + (-2 - 4) == -10.
+    const auto unigramActual = TBigramRecognizer::Recognize(text, unigramModel);
+    Assert::AreEqual(TWeight(-9), unigramActual.first, "Unigram cost");
+
+    const vector<TWordPosition> unigramPositions{ { 0, 2 },{ 2, 5 } };
+    Assert::AreEqual(unigramPositions, unigramActual.second, "Unigram positions");
+
+    Assert::ExpectException<runtime_error>(
+      [&](void) -> void { TBigramModel({ { "no", -3, 0 } }, { { "no", "now", -1 } }, -10); },
+      "The second word 'now' must be a unigram.", "Bigram of unknown word");
+  }
+
+  //There are more blocks of the texts than the threads,
+  // and the texts differ, so that a result in a wrong place is seen.
+  void RunBatch(const TestCase& testCase)
+  {
+    constexpr size_t threadCount = 3;
+    constexpr size_t textCount = 1000;
+
+    vector<string> texts;
+    texts.reserve(textCount);
+    for (size_t index = 0; index < textCount; ++index)
+    {
+      const auto length = 1 + index % testCase.Text.size();
+      texts.push_back(testCase.Text.substr(0, length) + to_string(index));
+    }
+
+    const auto textsEnd = texts.data() + texts.size();
+    const auto results = TWordRecognizer::RecognizeBatch(
+      texts.data(), textsEnd, testCase.Words, threadCount);
+    Assert::AreEqual(texts.size(), results.size(), "Batch size");
+
+    for (size_t index = 0; index < textCount; ++index)
+    {
+      const auto expected = TWordRecognizer::Recognize(texts[index], testCase.Words);
+      const auto name = "Batch_" + to_string(index);
+      Assert::AreEqual(expected.first, results[index].first, name + " cost");
+      Assert::AreEqual(expected.second, results[index].second, name + " positions");
+    }
+
+    //The threads of a pool are reused by the calls.
+    ParallelUtilities::ThreadPool pool(threadCount);
+    for (size_t call = 0; call < 2; ++call)
+    {
+      const auto poolResults = TWordRecognizer::RecognizeBatch(
+        texts.data(), textsEnd, testCase.Words, pool);
+      Assert::AreEqual(results.size(), poolResults.size(), "Batch pool size");
+
+      for (size_t index = 0; index < textCount; ++index)
+      {
+        const auto name = "Batch pool_" + to_string(index);
+        Assert::AreEqual(results[index].first, poolResults[index].first, name + " cost");
+        Assert::AreEqual(results[index].second, poolResults[index].second, name + " positions");
+      }
+    }
+  }
+
+  template <typename TAction>
+  size_t CountAllocations(const TAction& action)
+  {
+    const auto before = AllocationCount.load();
+    action();
+    return AllocationCount.load() - before;
+  }
+
+  //Once the Workspace has grown, a call must make no heap allocations.
+  void WorkspaceAllocationTest()
+  {
+    const TDictionary words{ "a", "ab", "abc", "bcd", "cd", "dab" };
+    const DoubleArrayTrie<TSize> trie(words);
+
+    string text;
+    for (size_t index = 0; index < 1000; ++index)
+    {
+      text += "abcdab"[index % 6];
+      if (0 == index % 7)
+      {
+        text += 'z';
+      }
+    }
+
+    constexpr TSize maxLength = 3;
+    constexpr size_t callCount = 10;
+
+    TWordRecognizer::Workspace workspace;
+    vector<TWordPosition> positions;
+
+    //Warm up: the buffers grow to the text size.
+    const auto expected = TWordRecognizer::Recognize(text, words, maxLength, workspace, positions);
+    Assert::AreEqual(expected, TWordRecognizer::Recognize(text, trie, workspace, positions),
+      "Workspace_Trie allocation weight");
+
+    //An Assert makes strings, so that the results are checked after counting.
+    size_t mismatchCount = 0;
+    const auto allocationCount = CountAllocations([&](void) -> void
+    {
+      for (size_t call = 0; call < callCount; ++call)
+      {
+        mismatchCount += expected != TWordRecognizer::Recognize(text, words, maxLength, workspace, positions);
+      }
+    });
+
+    Assert::AreEqual(size_t(0), allocationCount, "Workspace allocations");
+    Assert::AreEqual(size_t(0), mismatchCount, "Workspace allocation mismatches");
+
+    const auto trieAllocationCount = CountAllocations([&](void) -> void
+    {
+      for (size_t call = 0; call < callCount; ++call)
+      {
+        mismatchCount += expected != TWordRecognizer::Recognize(text, trie, workspace, positions);
+      }
+    });
+
+    Assert::AreEqual(size_t(0), trieAllocationCount, "Workspace_Trie allocations");
+    Assert::AreEqual(size_t(0), mismatchCount, "Workspace_Trie allocation mismatches");
+  }
+
   void RunTestCase(const TestCase& testCase)
   {
-    const auto costPositions = TWordRecognizer::Recognize(testCase.Text, testCase.Words);
-    Assert::AreEqual(testCase.ExpectedCost, costPositions.first, "Cost");
-    Assert::AreEqual(testCase.ExpectedPositions, costPositions.second, "Positions");
+    {
+      const auto costPositions = TWordRecognizer::Recognize(testCase.Text, testCase.Words);
+      CheckResult(testCase, costPositions, "Dictionary");
+    }
+
+    {//An ASCII text has the same bytes and codepoints.
+      const auto utf8 = TWordRecognizer::RecognizeUtf8(testCase.Text, testCase.Words);
+      TWordRecognizer::CostAndPositions costPositions{ utf8.first, {} };
+      for (const auto& position : utf8.second)
+      {
+        Assert::AreEqual(position.Bytes, position.Codepoints, "Utf8 position");
+        costPositions.second.push_back(position.Bytes);
+      }
+
+      CheckResult(testCase, costPositions, "Utf8");
+    }
+
+    {
+      const WordPrefilter<TSize> prefilter(testCase.Words);
+      for (const auto& word : testCase.Words)
+      {
+        Assert::AreEqual(true, prefilter.HasLength(word.size()), "Prefilter length");
+      }
+
+      const auto costPositions = TWordRecognizer::Recognize(testCase.Text, testCase.Words, prefilter);
+      CheckResult(testCase, costPositions, "Prefilter");
+    }
+
+    RunBest(testCase);
+    RunBigram(testCase);
+    RunBatch(testCase);
+    {
+      const DoubleArrayTrie<TSize> trie(testCase.Words);
+      const auto costPositions = TWordRecognizer::Recognize(testCase.Text, trie);
+      CheckResult(testCase, costPositions, "Trie");
+
+      const auto exact = TWordRecognizer::RecognizeApproximate(testCase.Text, trie, 0);
+      CheckResult(testCase, exact, "Approximate_0");
+
+      RunIncremental(testCase, trie);
+
+      //A longer text goes first, so that the buffers are reused.
+      const auto longerText = testCase.Text + testCase.Text;
+
+      TWordRecognizer::Workspace workspace;
+      TWordRecognizer::CostAndPositions reused;
+      TWordRecognizer::Recognize(longerText, testCase.Words, 0, workspace, reused.second);
+      reused.first = TWordRecognizer::Recognize(testCase.Text, testCase.Words, 0, workspace, reused.second);
+      CheckResult(testCase, reused, "Workspace");
+
+      TWordRecognizer::Recognize(longerText, trie, workspace, reused.second);
+      reused.first = TWordRecognizer::Recognize(testCase.Text, trie, workspace, reused.second);
+      CheckResult(testCase, reused, "Workspace_Trie");
+    }
+    {
+      const AhoCorasick<TSize> automaton(testCase.Words);
+      const auto costPositions = TWordRecognizer::Recognize(testCase.Text, automaton);
+      CheckResult(testCase, costPositions, "AhoCorasick");
+
+      RunStreaming(testCase, automaton);
+
+      constexpr size_t threadCount = 3;
+      for (size_t chunkSize = 1; chunkSize <= testCase.Text.size(); ++chunkSize)
+      {
+        const auto parallel = TWordRecognizer::RecognizeParallel(
+          testCase.Text, automaton, threadCount, chunkSize);
+        CheckResult(testCase, parallel, "Parallel_" + to_string(chunkSize));
+      }
+    }
+    {
+      const TemporaryFile file("WordRecognizerTests.dictionary");
+      MappedDictionary::Write(file.get_Path(), testCase.Words);
+
+      const MappedDictionary words(file.get_Path());
+      Assert::AreEqual(testCase.Words.size(), words.size(), "Mapped size");
+
+      const auto costPositions = WordRecognizer<TSize, TWeight, MappedDictionary>
+        ::Recognize(testCase.Text, words);
+      CheckResult(testCase, costPositions, "Mapped");
+    }
   }
 }
 
 void MyCompany::Algorithms::Regression::Tests::WordRecognizerTests(void)
 {
   TestUtilities<TestCase>::Test(RunTestCase, GenerateTestCases);
+  ScoringTests();
+  Utf8Tests();
+  BestNarrowSizeTest();
+  ApproximateTest();
+  LargeTrieTest();
+  LargeTrieBuildTimeTest();
+  MappedDictionaryCorruptTest();
+  WorkspaceAllocationTest();
+  DictionaryHolderTest();
+  BigramTest();
 }
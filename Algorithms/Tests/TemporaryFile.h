@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Tests
+    {
+      //A file name in the temporary directory, not in the current one.
+      //The file is removed both before the use and on the scope exit,
+      // so that a failed assertion does not leave it behind.
+      class TemporaryFile final
+      {
+        std::string _Path;
+
+      public:
+
+        explicit TemporaryFile(const std::string& name)
+          : _Path(Directory() + name)
+        {
+          std::remove(_Path.c_str());
+        }
+
+        ~TemporaryFile()
+        {
+          std::remove(_Path.c_str());
+        }
+
+        TemporaryFile(const TemporaryFile&) = delete;
+        TemporaryFile& operator = (const TemporaryFile&) = delete;
+
+        inline const std::string& get_Path() const
+        {
+          return _Path;
+        }
+
+      private:
+
+        static std::string Directory()
+        {
+          for (const auto variable : { "TMPDIR", "TEMP", "TMP" })
+          {
+            const auto value = std::getenv(variable);
+            if (nullptr != value && 0 != *value)
+            {
+              std::string result(value);
+              if ('/' != result.back() && '\\' != result.back())
+              {
+                result += '/';
+              }
+
+              return result;
+            }
+          }
+
+#ifdef _WIN32
+          return std::string();
+#else
+          return "/tmp/";
+#endif
+        }
+      };
+    }
+  }
+}
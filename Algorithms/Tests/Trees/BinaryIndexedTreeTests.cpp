@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <vector>
 #include <tuple>
+#include <utility>
 #include "../BinaryIndexedTree.h"
 #include "../../Assert.h"
 #include "BinaryIndexedTreeTests.h"
@@ -32,6 +33,59 @@ namespace
     return result;
   }
 
+  //The same as the CreateTree, but in linear time.
+  Tree CreateTreeFromValues()
+  {
+    const vector<Number> values{ 2, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    Tree result(values.cbegin(), values.cend());
+    return result;
+  }
+
+  void CheckSameValues(const Tree& expected, const Tree& actual, const string& stepName)
+  {
+    Assert::AreEqual(expected.max_index(), actual.max_index(), stepName + "_max_index");
+
+    for (auto i = Tree::InitialIndex; i <= expected.max_index(); ++i)
+    {
+      const auto name = stepName + "_at_" + to_string(i);
+      Assert::AreEqual(expected.get(i), actual.get(i), name);
+    }
+  }
+
+  //A batch must give the same sums as adding one at a time.
+  void TestBatchAdd(const vector<pair<size_t, Number>>& increments, const string& stepName)
+  {
+    auto expected = CreateTree();
+    for (const auto& increment : increments)
+    {
+      expected.add(increment.first, increment.second);
+    }
+
+    auto actual = CreateTree();
+    actual.add(increments);
+    CheckSameValues(expected, actual, stepName);
+  }
+
+  //Compare to a linear scan over the prefix sums.
+  void TestLowerBound(const Tree& tree, const string& stepName)
+  {
+    const auto maxIndex = tree.max_index();
+    const auto total = tree.get(maxIndex);
+
+    for (auto prefixSum = static_cast<Number>(-1); prefixSum <= total + 1; ++prefixSum)
+    {
+      auto expected = Tree::InitialIndex;
+      while (expected <= maxIndex && tree.get(expected) < prefixSum)
+      {
+        ++expected;
+      }
+
+      const auto actual = tree.lower_bound(prefixSum);
+      Assert::AreEqual(expected, actual, stepName + "_lower_bound_" + to_string(prefixSum));
+    }
+  }
+
   void CheckIndexOutOfRange(const Tree& tree)
   {
     const auto maxIndex = tree.max_index();
@@ -126,9 +180,21 @@ void MyCompany::Algorithms::Trees::Tests::BinaryIndexedTreeTests(void)
     const auto requests = GetRequests1();
     CheckRequests(tree, requests, "step1");
   }
+  TestLowerBound(tree, "step1");
+  Assert::AreEqual(size_t(12), tree.lower_bound(7), "lower_bound of the total");
   MakeChanges(tree);
   {
     const auto requests = GetRequests2();
     CheckRequests(tree, requests, "step2");
   }
+  TestLowerBound(Tree(1), "single");
+  {
+    auto fromValues = CreateTreeFromValues();
+    CheckSameValues(CreateTree(), fromValues, "fromValues");
+    CheckRequests(fromValues, GetRequests1(), "fromValues_step1");
+  }
+
+  TestBatchAdd({ { 1, 30 },{ 3, 500 },{ 6, 7000 } }, "batchSparse");
+  TestBatchAdd({ { 12, 4 },{ 1, 30 },{ 3, 500 },{ 6, 7000 },{ 3, -2 },{ 8, 9 },
+    { 2, 1 },{ 12, 1 },{ 5, 5 },{ 7, 7 },{ 11, 11 } }, "batchDense");
 }
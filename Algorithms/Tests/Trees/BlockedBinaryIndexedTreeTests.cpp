@@ -0,0 +1,80 @@
+#include <string>
+#include <vector>
+#include "../BinaryIndexedTree.h"
+#include "../BlockedBinaryIndexedTree.h"
+#include "../../Assert.h"
+#include "BlockedBinaryIndexedTreeTests.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+using namespace MyCompany::Algorithms;
+
+namespace
+{
+  using Number = long long;
+
+  //Not a multiple of the block sizes, so that the last block is partial.
+  constexpr size_t MaxIndex = 75;
+
+  //The blocked tree must return the same sums as the plain one.
+  template <size_t BlockSize>
+  void TestBlockSize(const string& name)
+  {
+    BinaryIndexedTree<Number> expected(MaxIndex);
+    BlockedBinaryIndexedTree<Number, BlockSize> tree(MaxIndex);
+    Assert::AreEqual(MaxIndex, tree.max_index(), name + " max_index");
+
+    for (size_t step = 0; step < 3 * MaxIndex; ++step)
+    {
+      const auto index = (step * 17) % MaxIndex + 1;
+      const auto increment = static_cast<Number>(step % 7) - 3;
+      expected.add(index, increment);
+      tree.add(index, increment);
+    }
+
+    vector<Number> values;
+    for (size_t index = 1; index <= MaxIndex; ++index)
+    {
+      values.push_back(expected.value_at(index));
+      Assert::AreEqual(values.back(), tree.value_at(index),
+        name + " value_at " + to_string(index));
+    }
+
+    const BlockedBinaryIndexedTree<Number, BlockSize> built(values.begin(), values.end());
+    Assert::AreEqual(MaxIndex, built.max_index(), name + " built max_index");
+    for (size_t index = 1; index <= MaxIndex; ++index)
+    {
+      Assert::AreEqual(expected.get(index), built.get(index),
+        name + " built " + to_string(index));
+    }
+
+    for (size_t left = 0; left <= MaxIndex; ++left)
+    {
+      for (auto right = max(left, size_t(1)); right <= MaxIndex; ++right)
+      {
+        const auto stepName = name + " " + to_string(left) + ", " + to_string(right);
+        Assert::AreEqual(expected.get(left, right), tree.get(left, right), stepName);
+      }
+    }
+
+    const string expectedMessage = "The index (76) must be between 1 and 75.";
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.add(MaxIndex + 1); },
+      expectedMessage, name + " CheckIndexOutOfRange");
+
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.get(MaxIndex + 1); },
+      expectedMessage, name + " CheckIndexOutOfRange get");
+  }
+}
+
+void MyCompany::Algorithms::Trees::Tests::BlockedBinaryIndexedTreeTests(void)
+{
+  TestBlockSize<1>("Block1");
+  TestBlockSize<4>("Block4");
+  TestBlockSize<16>("Block16");
+  TestBlockSize<64>("Block64");
+
+  //Fewer slots than a block.
+  TestBlockSize<128>("Block128");
+}
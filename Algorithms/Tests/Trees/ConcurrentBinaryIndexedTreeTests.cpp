@@ -0,0 +1,198 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../BinaryIndexedTree.h"
+#include "../ConcurrentBinaryIndexedTree.h"
+#include "../ShardedBinaryIndexedTree.h"
+#include "../../Assert.h"
+#include "ConcurrentBinaryIndexedTreeTests.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+using namespace MyCompany::Algorithms;
+
+namespace
+{
+  using Number = long long;
+
+  constexpr size_t MaxIndex = 37;
+  constexpr size_t ThreadCount = 4;
+  constexpr size_t AddsPerThread = 5000;
+
+  //The same increments, whatever the tree.
+  size_t IndexToAdd(const size_t threadIndex, const size_t step)
+  {
+    return (threadIndex * 7 + step * 13) % MaxIndex + 1;
+  }
+
+  Number Increment(const size_t threadIndex, const size_t step)
+  {
+    return static_cast<Number>((threadIndex + step) % 5) - 1;
+  }
+
+  BinaryIndexedTree<Number> CreateExpected()
+  {
+    BinaryIndexedTree<Number> result(MaxIndex);
+    for (size_t threadIndex = 0; threadIndex < ThreadCount; ++threadIndex)
+    {
+      for (size_t step = 0; step < AddsPerThread; ++step)
+      {
+        result.add(IndexToAdd(threadIndex, step), Increment(threadIndex, step));
+      }
+    }
+
+    return result;
+  }
+
+  //The threads add concurrently, then all the sums must be exact.
+  template <typename Tree>
+  void TestTree(Tree& tree, const string& name)
+  {
+    Assert::AreEqual(MaxIndex, tree.max_index(), name + " max_index");
+
+    vector<thread> threads;
+    for (size_t threadIndex = 0; threadIndex < ThreadCount; ++threadIndex)
+    {
+      threads.emplace_back([&tree, threadIndex]()
+      {
+        for (size_t step = 0; step < AddsPerThread; ++step)
+        {
+          tree.add(IndexToAdd(threadIndex, step), Increment(threadIndex, step));
+        }
+      });
+    }
+
+    for (auto& worker : threads)
+    {
+      worker.join();
+    }
+
+    const auto expected = CreateExpected();
+    for (size_t left = 0; left <= MaxIndex; ++left)
+    {
+      for (auto right = max(left, size_t(1)); right <= MaxIndex; ++right)
+      {
+        const auto stepName = name + " " + to_string(left) + ", " + to_string(right);
+        Assert::AreEqual(expected.get(left, right), tree.get(left, right), stepName);
+      }
+    }
+
+    const string expectedMessage = "The index (38) must be between 1 and 37.";
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.add(MaxIndex + 1); },
+      expectedMessage, name + " CheckIndexOutOfRange");
+  }
+
+  //While the writers add ones, the readers see consistent shards:
+  // a range sum is between 0 and the total, and the total never decreases.
+  void ShardedReadersTest()
+  {
+    ShardedBinaryIndexedTree<Number> tree(MaxIndex);
+
+    atomic<size_t> runningWriters(ThreadCount);
+    atomic<size_t> badRanges(0);
+    atomic<size_t> decreasedTotals(0);
+
+    vector<thread> threads;
+    for (size_t threadIndex = 0; threadIndex < ThreadCount; ++threadIndex)
+    {
+      threads.emplace_back([&, threadIndex]()
+      {
+        for (size_t step = 0; step < AddsPerThread; ++step)
+        {
+          tree.add(IndexToAdd(threadIndex, step));
+        }
+
+        --runningWriters;
+      });
+
+      threads.emplace_back([&, threadIndex]()
+      {
+        Number previousTotal = 0;
+        for (size_t step = 0; 0 < runningWriters.load(); ++step)
+        {
+          const auto left = IndexToAdd(threadIndex, step);
+          const auto right = max(left, IndexToAdd(threadIndex + 1, step));
+          const auto range = tree.get(left, right);
+
+          const auto total = tree.get(MaxIndex);
+          if (range < 0 || total < range)
+          {
+            ++badRanges;
+          }
+
+          if (total < previousTotal)
+          {
+            ++decreasedTotals;
+          }
+
+          previousTotal = total;
+        }
+      });
+    }
+
+    for (auto& worker : threads)
+    {
+      worker.join();
+    }
+
+    Assert::AreEqual(size_t(0), badRanges.load(), "Sharded readers badRanges");
+    Assert::AreEqual(size_t(0), decreasedTotals.load(), "Sharded readers decreasedTotals");
+    Assert::AreEqual(true, tree.shard_count() <= ThreadCount, "Sharded readers shard_count");
+    Assert::AreEqual(static_cast<Number>(ThreadCount * AddsPerThread), tree.get(MaxIndex),
+      "Sharded readers total");
+  }
+
+  //The writer threads come and go, and the new ones reuse the shards.
+  void ShardedChurningWritersTest()
+  {
+    constexpr size_t maxShardCount = 2;
+    constexpr size_t rounds = 50;
+    constexpr size_t addsPerRound = 100;
+
+    ShardedBinaryIndexedTree<Number> tree(MaxIndex, maxShardCount);
+    for (size_t round = 0; round < rounds; ++round)
+    {
+      vector<thread> threads;
+      for (size_t threadIndex = 0; threadIndex <= maxShardCount; ++threadIndex)
+      {
+        threads.emplace_back([&tree, threadIndex]()
+        {
+          for (size_t step = 0; step < addsPerRound; ++step)
+          {
+            tree.add(IndexToAdd(threadIndex, step));
+          }
+        });
+      }
+
+      for (auto& worker : threads)
+      {
+        worker.join();
+      }
+    }
+
+    Assert::AreEqual(true, tree.shard_count() <= maxShardCount, "Sharded churning shard_count");
+    Assert::AreEqual(static_cast<Number>(rounds * (maxShardCount + 1) * addsPerRound),
+      tree.get(MaxIndex), "Sharded churning total");
+  }
+}
+
+void MyCompany::Algorithms::Trees::Tests::ConcurrentBinaryIndexedTreeTests(void)
+{
+  {
+    ConcurrentBinaryIndexedTree<Number> tree(MaxIndex);
+    TestTree(tree, "Concurrent");
+  }
+  {
+    //No more shards than the concurrent writers.
+    ShardedBinaryIndexedTree<Number> tree(MaxIndex);
+    Assert::AreEqual(size_t(0), tree.shard_count(), "Sharded shard_count empty");
+    TestTree(tree, "Sharded");
+    const auto shardCount = tree.shard_count();
+    Assert::AreEqual(true, 0 < shardCount && shardCount <= ThreadCount, "Sharded shard_count");
+  }
+
+  ShardedReadersTest();
+  ShardedChurningWritersTest();
+}
@@ -0,0 +1,176 @@
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "../BinaryIndexedTree.h"
+#include "../MappedBinaryIndexedTreeStorage.h"
+#include "../../Assert.h"
+#include "../TemporaryFile.h"
+#include "MappedBinaryIndexedTreeStorageTests.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+using namespace MyCompany::Algorithms;
+using MyCompany::Algorithms::Tests::TemporaryFile;
+
+namespace
+{
+  using Number = long long;
+  using Storage = MappedBinaryIndexedTreeStorage<Number>;
+  using MappedTree = BinaryIndexedTree<Number, Storage>;
+
+  constexpr size_t MaxIndex = 37;
+
+  //The file layout.
+  constexpr size_t SlotSize = 512;
+  constexpr size_t GenerationOffset = 40;
+  constexpr size_t NodesOffset = 4096;
+  constexpr size_t RecordOffset = NodesOffset + (MaxIndex + 1) * sizeof(Number);
+
+  void BreakByte(const string& fileName, const size_t offset)
+  {
+    fstream file(fileName, ios::in | ios::out | ios::binary);
+    file.seekg(offset);
+    const auto value = static_cast<char>(file.get());
+
+    file.seekp(offset);
+    file.put(static_cast<char>(~value));
+  }
+
+  uint64_t ReadGeneration(const string& fileName, const size_t slot)
+  {
+    ifstream file(fileName, ios::binary);
+    file.seekg(slot * SlotSize + GenerationOffset);
+
+    uint64_t result = 0;
+    file.read(reinterpret_cast<char*>(&result), sizeof result);
+    return result;
+  }
+
+  //As if the last header write was torn by a crash.
+  void BreakNewestHeader(const string& fileName)
+  {
+    const auto slot = ReadGeneration(fileName, 0) < ReadGeneration(fileName, 1) ? 1 : 0;
+    BreakByte(fileName, slot * SlotSize + GenerationOffset);
+  }
+
+  template <typename Tree>
+  void AddValues(Tree& tree, const size_t seed)
+  {
+    for (size_t step = 0; step < 3 * MaxIndex; ++step)
+    {
+      const auto index = (step * 13 + seed) % MaxIndex + 1;
+      tree.add(index, static_cast<Number>((step + seed) % 7) - 3);
+    }
+  }
+
+  void CheckSameSums(const BinaryIndexedTree<Number>& expected,
+    const MappedTree& tree, const string& name)
+  {
+    Assert::AreEqual(expected.max_index(), tree.max_index(), name + " max_index");
+
+    for (size_t left = 0; left <= MaxIndex; ++left)
+    {
+      for (auto right = max(left, size_t(1)); right <= MaxIndex; ++right)
+      {
+        const auto stepName = name + " " + to_string(left) + ", " + to_string(right);
+        Assert::AreEqual(expected.get(left, right), tree.get(left, right), stepName);
+      }
+    }
+  }
+
+  //The dirty blocks, both apart and consecutive, are written in the block order.
+  void ManyBlocksTest()
+  {
+    const TemporaryFile file("MappedBinaryIndexedTreeStorageTests_blocks.bit");
+    constexpr size_t maxIndex = 5000;
+
+    BinaryIndexedTree<Number> expected(maxIndex);
+    {
+      MappedTree tree(AdoptNodes, Storage(file.get_Path(), maxIndex));
+      for (const size_t index : { 4700, 200, 2100, 1, 700, 4999 })
+      {
+        const auto increment = static_cast<Number>(index % 11) + 1;
+        expected.add(index, increment);
+        tree.add(index, increment);
+      }
+
+      Assert::AreEqual(true, 1 < tree.max_index() / (4096 / sizeof(Number)), "Many blocks");
+      tree.flush();
+    }
+
+    const MappedTree tree(AdoptNodes, Storage(file.get_Path(), 0));
+    for (size_t index = 1; index <= maxIndex; ++index)
+    {
+      Assert::AreEqual(expected.get(index), tree.get(index), "Many blocks " + to_string(index));
+    }
+  }
+}
+
+void MyCompany::Algorithms::Trees::Tests::MappedBinaryIndexedTreeStorageTests(void)
+{
+  const TemporaryFile file("MappedBinaryIndexedTreeStorageTests.bit");
+  const auto& fileName = file.get_Path();
+
+  BinaryIndexedTree<Number> expected(MaxIndex);
+  AddValues(expected, 0);
+  {
+    MappedTree tree(AdoptNodes, Storage(fileName, MaxIndex));
+    CheckSameSums(BinaryIndexedTree<Number>(MaxIndex), tree, "Created");
+
+    AddValues(tree, 0);
+    CheckSameSums(expected, tree, "Added");
+    tree.flush();
+  }
+  {
+    //The max index is taken from the file.
+    MappedTree tree(AdoptNodes, Storage(fileName, 0));
+    CheckSameSums(expected, tree, "Reopened");
+
+    AddValues(expected, 5);
+    AddValues(tree, 5);
+    tree.flush();
+  }
+  {
+    MappedTree tree(AdoptNodes, Storage(fileName, MaxIndex));
+    CheckSameSums(expected, tree, "Checkpoint");
+
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.add(MaxIndex + 1); },
+      "The index (38) must be between 1 and 37.", "CheckIndexOutOfRange");
+
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { Storage(fileName, MaxIndex + 1); },
+      "The file '" + fileName + "' has the max index 37, but 38 is required.", "WrongMaxIndex");
+
+    Assert::ExpectException<runtime_error>(
+      [&](void) -> void { MappedBinaryIndexedTreeStorage<int>(fileName, 0); },
+      "The file '" + fileName + "' is not a valid tree of 4-byte 'i' numbers, size=8512.",
+      "WrongElementType");
+
+    //No flush after the add: the file keeps the last checkpoint.
+    tree.add(1);
+  }
+  {
+    MappedTree tree(AdoptNodes, Storage(fileName, MaxIndex));
+    CheckSameSums(expected, tree, "Last checkpoint");
+  }
+
+  //A crash after the commit, but before the nodes are written:
+  // the newest header is torn, so the older one, having the records of the checkpoint,
+  // is used, and they are replayed over the nodes.
+  BreakNewestHeader(fileName);
+  BreakByte(fileName, NodesOffset + 5 * sizeof(Number));
+  {
+    MappedTree tree(AdoptNodes, Storage(fileName, 0));
+    CheckSameSums(expected, tree, "Replayed");
+  }
+
+  BreakNewestHeader(fileName);
+  BreakByte(fileName, RecordOffset + 100);
+  Assert::ExpectException<runtime_error>(
+    [&](void) -> void { Storage(fileName, MaxIndex); },
+    "The file '" + fileName + "' has the damaged record 0 of the last checkpoint, and must be rebuilt.",
+    "DamagedRecord");
+
+  ManyBlocksTest();
+}
\ No newline at end of file
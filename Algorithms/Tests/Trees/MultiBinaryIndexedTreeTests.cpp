@@ -0,0 +1,158 @@
+#include <array>
+#include <vector>
+#include "../MultiBinaryIndexedTree.h"
+#include "../../Assert.h"
+#include "MultiBinaryIndexedTreeTests.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+using namespace MyCompany::Algorithms;
+
+namespace
+{
+  using Number = int;
+
+  //Call the "action" for each index of the box between "from" and "to" inclusively.
+  template <typename Index, typename TAction>
+  void ForEachIndex(const Index& from, const Index& to, TAction action)
+  {
+    auto index = from;
+    for (;;)
+    {
+      action(index);
+
+      auto dimension = index.size();
+      for (;;)
+      {
+        if (0 == dimension)
+        {
+          return;
+        }
+
+        --dimension;
+        if (index[dimension] < to[dimension])
+        {
+          ++index[dimension];
+          break;
+        }
+
+        index[dimension] = from[dimension];
+      }
+    }
+  }
+
+  string ToString(const vector<size_t>& index)
+  {
+    string result;
+    for (const auto& item : index)
+    {
+      result += (result.empty() ? "" : ", ") + to_string(item);
+    }
+
+    return result;
+  }
+
+  //Compare the sums over all the boxes to the ones of the plain "values".
+  template <size_t Dimensions, typename TOffset>
+  void CheckBoxes(const MultiBinaryIndexedTree<Number, Dimensions>& tree,
+    const vector<Number>& values,
+    TOffset offset,
+    const string& stepName)
+  {
+    using Index = typename MultiBinaryIndexedTree<Number, Dimensions>::Index;
+
+    Index first, last;
+    for (size_t dimension = 0; dimension < Dimensions; ++dimension)
+    {
+      first[dimension] = 1;
+      last[dimension] = tree.max_index(dimension);
+    }
+
+    ForEachIndex(first, last, [&](const Index& left)
+    {
+      ForEachIndex(left, last, [&](const Index& right)
+      {
+        Number expected{};
+        ForEachIndex(left, right, [&](const Index& cell)
+        {
+          expected += values[offset(cell)];
+        });
+
+        const auto actual = tree.get(left, right);
+        const auto name = stepName + " " + ToString({ left.begin(), left.end() })
+          + " to " + ToString({ right.begin(), right.end() });
+        Assert::AreEqual(expected, actual, name);
+
+        if (left == first)
+        {
+          Assert::AreEqual(expected, tree.get(right), name + " prefix");
+        }
+      });
+    });
+  }
+
+  void Test2D()
+  {
+    using Tree = MultiBinaryIndexedTree<Number, 2>;
+
+    constexpr size_t rows = 5, columns = 7;
+    Tree tree({ rows, columns });
+    Assert::AreEqual(rows, tree.max_index(0), "max_index 0");
+    Assert::AreEqual(columns, tree.max_index(1), "max_index 1");
+
+    vector<Number> values((rows + 1) * (columns + 1));
+    const auto offset = [](const Tree::Index& index)
+    {
+      return index[0] * (columns + 1) + index[1];
+    };
+
+    ForEachIndex(Tree::Index{ 1, 1 }, Tree::Index{ rows, columns }, [&](const Tree::Index& cell)
+    {
+      const auto increment = static_cast<Number>(cell[0] * 10 + cell[1]);
+      tree.add(cell, increment);
+      values[offset(cell)] += increment;
+    });
+
+    tree.add({ 3, 4 }, -1000);
+    values[offset({ 3, 4 })] -= 1000;
+
+    CheckBoxes(tree, values, offset, "2D");
+
+    const string expectedMessage = "The index (8) must be between 1 and 7 in the dimension 1.";
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.add({ 1, 8 }); },
+      expectedMessage, "2D CheckIndexOutOfRange");
+  }
+
+  void Test3D()
+  {
+    using Tree = MultiBinaryIndexedTree<Number, 3>;
+
+    Tree tree({ 3, 4, 5 });
+
+    vector<Number> values(4 * 5 * 6);
+    const auto offset = [](const Tree::Index& index)
+    {
+      return (index[0] * 5 + index[1]) * 6 + index[2];
+    };
+
+    const vector<pair<Tree::Index, Number>> changes{
+      { { 1, 1, 1 }, 1 },{ { 3, 4, 5 }, 20 },{ { 2, 2, 3 }, 300 },
+      { { 2, 4, 1 }, -7 },{ { 1, 3, 5 }, 50 },{ { 2, 2, 3 }, 4000 },
+    };
+
+    for (const auto& change : changes)
+    {
+      tree.add(change.first, change.second);
+      values[offset(change.first)] += change.second;
+    }
+
+    CheckBoxes(tree, values, offset, "3D");
+  }
+}
+
+void MyCompany::Algorithms::Trees::Tests::MultiBinaryIndexedTreeTests(void)
+{
+  Test2D();
+  Test3D();
+}
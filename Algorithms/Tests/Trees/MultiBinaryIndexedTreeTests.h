@@ -0,0 +1,15 @@
+#pragma once
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Trees
+    {
+      namespace Tests
+      {
+				void MultiBinaryIndexedTreeTests(void);
+      }
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <vector>
+#include <tuple>
+#include "../RangeBinaryIndexedTree.h"
+#include "../../Assert.h"
+#include "RangeBinaryIndexedTreeTests.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+using namespace MyCompany::Algorithms;
+
+namespace
+{
+  using Number = int;
+  using Tree = RangeBinaryIndexedTree<Number>;
+
+  //leftIndex, rightIndex, increment.
+  using Change = tuple<size_t, size_t, Number>;
+
+  constexpr size_t MaxIndex = 13;
+
+  //Compare all the sums to the ones of the plain "values".
+  void CheckSums(const Tree& tree, const vector<Number>& values, const string& stepName)
+  {
+    for (size_t left = Tree::InitialIndex; left <= MaxIndex; ++left)
+    {
+      Number expected{};
+      for (auto right = left; right <= MaxIndex; ++right)
+      {
+        expected += values[right];
+
+        const auto actual = tree.get(left, right);
+        const string separator = ", ";
+        const auto name = to_string(left) + separator + to_string(right) + separator + stepName;
+        Assert::AreEqual(expected, actual, name);
+      }
+
+      Assert::AreEqual(values[left], tree.value_at(left), stepName + "_at_" + to_string(left));
+    }
+  }
+
+  void CheckIndexOutOfRange(Tree& tree)
+  {
+    const auto tooLargeIndex = 123456789;
+    const string expectedMessage = "The index (123456789) must be between 1 and "
+      + to_string(MaxIndex) + ".";
+
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.get(tooLargeIndex); },
+      expectedMessage, "CheckIndexOutOfRange get");
+
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.add(2, tooLargeIndex, 1); },
+      expectedMessage, "CheckIndexOutOfRange add");
+  }
+}
+
+void MyCompany::Algorithms::Trees::Tests::RangeBinaryIndexedTreeTests(void)
+{
+  Tree tree(MaxIndex);
+  Assert::AreEqual(MaxIndex, tree.max_index(), "max_index");
+  CheckIndexOutOfRange(tree);
+
+  vector<Number> values(MaxIndex + 1);
+  CheckSums(tree, values, "empty");
+
+  const vector<Change> changes{
+    Change{ 1, 13, 5 }, Change{ 3, 7, 100 }, Change{ 4, 4, -20 },
+    Change{ 13, 13, 9 }, Change{ 1, 1, 7 }, Change{ 6, 12, -3 },
+    Change{ 2, 13, 1000 },
+  };
+
+  for (size_t index = 0; index < changes.size(); ++index)
+  {
+    const auto left = get<0>(changes[index]);
+    const auto right = get<1>(changes[index]);
+    const auto increment = get<2>(changes[index]);
+
+    if (left == right && 0 == index % 2)
+    {
+      tree.add(left, increment);
+    }
+    else
+    {
+      tree.add(left, right, increment);
+    }
+
+    for (auto slot = left; slot <= right; ++slot)
+    {
+      values[slot] += increment;
+    }
+
+    CheckSums(tree, values, "step" + to_string(index));
+  }
+}
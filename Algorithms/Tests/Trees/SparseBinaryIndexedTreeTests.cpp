@@ -0,0 +1,182 @@
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+#include "../CompressedBinaryIndexedTree.h"
+#include "../SparseBinaryIndexedTree.h"
+#include "../../Assert.h"
+#include "SparseBinaryIndexedTreeTests.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+using namespace MyCompany::Algorithms;
+
+namespace
+{
+  using Number = long long;
+  using Key = uint64_t;
+
+  //Far apart, including the extremes of the 64-bit range.
+  vector<Key> CreateKeys()
+  {
+    vector<Key> result{ 1, 2, 3, 1000, (Key(1) << 32) + 7, Key(1) << 40, Key(1) << 63,
+      numeric_limits<Key>::max() - 1, numeric_limits<Key>::max() };
+
+    for (Key key = 1; key <= 20; ++key)
+    {
+      result.push_back(key * 0x9E3779B97F4A7C15ull | 1);
+    }
+
+    return result;
+  }
+
+  //The expected sums, taken directly.
+  Number Sum(const map<Key, Number>& values, const Key leftInclusive, const Key rightInclusive)
+  {
+    Number result = 0;
+    for (auto it = values.lower_bound(leftInclusive);
+      it != values.end() && it->first <= rightInclusive; ++it)
+    {
+      result += it->second;
+    }
+
+    return result;
+  }
+
+  template <typename Tree>
+  void CheckSums(const Tree& tree, const map<Key, Number>& values,
+    const vector<Key>& keys, const string& name)
+  {
+    for (const auto& left : keys)
+    {
+      for (const auto& right : keys)
+      {
+        if (right < left)
+        {
+          continue;
+        }
+
+        const auto stepName = name + " " + to_string(left) + ", " + to_string(right);
+        Assert::AreEqual(Sum(values, left, right), tree.get(left, right), stepName);
+      }
+
+      Assert::AreEqual(Sum(values, 0, left), tree.get(left), name + " " + to_string(left));
+    }
+  }
+
+  void CompressedTest()
+  {
+    const auto keys = CreateKeys();
+
+    //The repeated keys must be ignored.
+    auto keysTwice = keys;
+    keysTwice.insert(keysTwice.end(), keys.begin(), keys.end());
+
+    CompressedBinaryIndexedTree<Number> tree(keysTwice.begin(), keysTwice.end());
+    Assert::AreEqual(keys.size(), tree.key_count(), "Compressed key_count");
+
+    map<Key, Number> values;
+    for (size_t step = 0; step < 3 * keys.size(); ++step)
+    {
+      const auto key = keys[(step * 7) % keys.size()];
+      const auto increment = static_cast<Number>(step % 5) - 2;
+      tree.add(key, increment);
+      values[key] += increment;
+    }
+
+    //The sums between the known keys too.
+    auto sumKeys = keys;
+    sumKeys.push_back(0);
+    sumKeys.push_back(999);
+    sumKeys.push_back(1001);
+    CheckSums(tree, values, sumKeys, "Compressed");
+
+    const string expectedMessage = "The key (999) must be one of the 29 keys, given to the constructor.";
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.add(999); },
+      expectedMessage, "Compressed CheckUnknownKey");
+  }
+
+  void SparseTest()
+  {
+    const auto keys = CreateKeys();
+
+    SparseBinaryIndexedTree<Number> tree;
+    Assert::AreEqual(numeric_limits<Key>::max(), tree.max_index(), "Sparse max_index");
+    Assert::AreEqual(size_t(0), tree.node_count(), "Sparse node_count empty");
+
+    map<Key, Number> values;
+    for (size_t step = 0; step < 3 * keys.size(); ++step)
+    {
+      const auto key = keys[(step * 7) % keys.size()];
+      const auto increment = static_cast<Number>(step % 5) - 2;
+      tree.add(key, increment);
+      values[key] += increment;
+    }
+
+    //At most a node per bit for a key.
+    const auto maxNodes = keys.size() * numeric_limits<Key>::digits;
+    Assert::AreEqual(true, tree.node_count() <= maxNodes, "Sparse node_count");
+
+    auto sumKeys = keys;
+    sumKeys.push_back(999);
+    sumKeys.push_back(1001);
+    CheckSums(tree, values, sumKeys, "Sparse");
+
+    SparseBinaryIndexedTree<Number> small(100);
+    const string expectedMessage = "The index (101) must be between 1 and 100.";
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { small.add(101); },
+      expectedMessage, "Sparse CheckIndexOutOfRange");
+
+    Assert::ExpectException<out_of_range>(
+      [&](void) -> void { tree.get(0); },
+      "The index (0) must be between 1 and 18446744073709551615.", "Sparse CheckIndexZero");
+  }
+
+  //SplitMix64: the keys, spread over the full 64-bit range.
+  Key NextRandom(Key& state)
+  {
+    auto result = (state += 0x9E3779B97F4A7C15ull);
+    result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ull;
+    result = (result ^ (result >> 27)) * 0x94D049BB133111EBull;
+    return result ^ (result >> 31);
+  }
+
+  void SparseRandomKeysTest()
+  {
+    SparseBinaryIndexedTree<Number> tree;
+    map<Key, Number> values;
+
+    Key state = 12345;
+    for (size_t step = 0; step < 5000; ++step)
+    {
+      const auto key = NextRandom(state) | 1;
+      tree.add(key);
+      values[key] += 1;
+    }
+
+    //The table is at most half full, so that a good hash keeps the probes short,
+    // while a poor one made them hundreds of cells long.
+    const auto maxProbe = tree.max_probe();
+    Assert::AreEqual(true, maxProbe <= 64,
+      "Sparse random max_probe " + to_string(maxProbe));
+
+    vector<Key> sumKeys;
+    for (auto it = values.begin(); it != values.end() && sumKeys.size() < 50; ++it)
+    {
+      sumKeys.push_back(it->first);
+    }
+
+    sumKeys.push_back(numeric_limits<Key>::max());
+    CheckSums(tree, values, sumKeys, "Sparse random");
+  }
+}
+
+void MyCompany::Algorithms::Trees::Tests::SparseBinaryIndexedTreeTests(void)
+{
+  CompressedTest();
+  SparseTest();
+  SparseRandomKeysTest();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Trees
+    {
+      namespace Tests
+      {
+				void SparseBinaryIndexedTreeTests(void);
+      }
+    }
+  }
+}
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <utility>
 #include <vector>
 #include <stdexcept>
+#include <type_traits>
 #include "../StreamUtilities.h"
 
 namespace MyCompany
@@ -9,17 +14,29 @@ namespace MyCompany
 	{
 		namespace Trees
 		{
+			//The tag of the constructor, taking the nodes of a tree as they are.
+			struct AdoptNodesTag final
+			{
+			};
+
+			constexpr AdoptNodesTag AdoptNodes{};
+
 			//Fenwick tree running time is O(log(N)), where N is the input size.
 			//It is ideal when 1) adding a number to a slot,
 			// and then 2) calculating the sum between consecutive slots i to j, where i <= j.
 			//Internally, a node stores the value of itself plus its left subtree.
 			//Linear space is required.
 			//
+			//The nodes are kept in the "TStorage", which has "size()" and "operator[]".
+			//Only the constructors, creating the storage, need its vector-like constructor of a size,
+			// and only the "flush()" needs its "flush()";
+			// see the MappedBinaryIndexedTreeStorage, given by the AdoptNodes, to keep them in a file.
+			//
 			//Note: The indexes start from 1.
-			template <typename Number>
+			template <typename Number, typename TStorage = std::vector<Number>>
 			class BinaryIndexedTree final
 			{
-				std::vector<Number> _Data;
+				TStorage _Data;
 
 			public:
 
@@ -27,6 +44,17 @@ namespace MyCompany
 
 				explicit BinaryIndexedTree(size_t initialSize);
 
+				//The values [begin, end) are put at the indexes from 1,
+				// in O(N) time rather than O(N*log(N)) of calling "add" N times.
+				//The range is passed twice, so the iterators must be at least forward ones.
+				template <typename TIterator>
+				BinaryIndexedTree(TIterator begin, TIterator end);
+
+				//Take the "storage" nodes as they are, e.g. of a tree saved before:
+				// they are not the values, so the tag must be given explicitly.
+				//There must be at least 2 nodes, the [0] being unused.
+				BinaryIndexedTree(AdoptNodesTag, TStorage&& storage);
+
 				//Return the maximum supported index.
 				inline size_t max_index() const
 				{
@@ -48,21 +76,80 @@ namespace MyCompany
 
 				void add(size_t index, const Number& increment = Number(1));
 
+				//Return the smallest index, whose prefix sum get(index) is at least the "prefixSum",
+				// or max_index() + 1 when there is none.
+				//All the values must be non-negative, e.g. frequencies.
+				//
+				//The tree is descended from the top node by halving steps, in O(log(N)),
+				// rather than binary searching with the "get", in O(log(N)^2).
+				size_t lower_bound(const Number& prefixSum) const;
+
+				//The same as calling the "add" for each of the (index, increment) pairs,
+				// but a node, shared by several update paths, is written once.
+				//Many increments are spread over all the nodes in O(N) time;
+				// a few are merged on their way up in O(U*log(K)),
+				// where U is the number of distinct nodes on the K paths.
+				void add(const std::vector<std::pair<size_t, Number>>& increments);
+
+				//Call the "flush()" of the storage, having one,
+				// e.g. to make a checkpoint of the file.
+				inline void flush()
+				{
+					_Data.flush();
+				}
+
 			private:
 
 				void check_index(const size_t index) const;
+
+				//Turn the values, kept in the nodes, into the tree in O(N):
+				// a node is complete, when all its children have been added,
+				// so that it is added to its parent once.
+				void build_from_values();
+
+				//The inverse of the "build_from_values()".
+				void restore_values();
 			};
 
-			template <typename Number>
-			BinaryIndexedTree<Number>::BinaryIndexedTree(size_t size)
+			template <typename Number, typename TStorage>
+			BinaryIndexedTree<Number, TStorage>::BinaryIndexedTree(size_t size)
 				: _Data(size <= 1
 					? 2 //Use 2 to generate the proper exception in the "check_index()".
 					: size + InitialIndex)
 			{
 			}
 
-			template <typename Number>
-			Number BinaryIndexedTree<Number>::get(
+			template <typename Number, typename TStorage>
+			BinaryIndexedTree<Number, TStorage>::BinaryIndexedTree(AdoptNodesTag, TStorage&& storage)
+				: _Data(std::move(storage))
+			{
+				if (_Data.size() <= InitialIndex)
+				{
+					std::ostringstream ss;
+					ss << "The storage must have at least 2 nodes, but has " << _Data.size() << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+			}
+
+			template <typename Number, typename TStorage>
+			template <typename TIterator>
+			BinaryIndexedTree<Number, TStorage>::BinaryIndexedTree(TIterator begin, TIterator end)
+				: BinaryIndexedTree(static_cast<size_t>(std::distance(begin, end)))
+			{
+				static_assert(std::is_base_of<std::forward_iterator_tag,
+					typename std::iterator_traits<TIterator>::iterator_category>::value,
+					"The std::distance would consume a single pass iterator; read the values into a container first.");
+
+				for (auto index = InitialIndex; begin != end; ++begin, ++index)
+				{
+					_Data[index] = *begin;
+				}
+
+				build_from_values();
+			}
+
+			template <typename Number, typename TStorage>
+			Number BinaryIndexedTree<Number, TStorage>::get(
 			  size_t leftInclusive, size_t rightInclusive) const
 			{
 #ifdef _DEBUG
@@ -81,8 +168,8 @@ namespace MyCompany
 				return result;
 			}
 
-			template <typename Number>
-			Number BinaryIndexedTree<Number>::get(size_t index) const
+			template <typename Number, typename TStorage>
+			Number BinaryIndexedTree<Number, TStorage>::get(size_t index) const
 			{
 				check_index(index);
 
@@ -96,8 +183,8 @@ namespace MyCompany
 				return result;
 			}
 
-			template <typename Number>
-			Number BinaryIndexedTree<Number>::value_at(size_t index) const
+			template <typename Number, typename TStorage>
+			Number BinaryIndexedTree<Number, TStorage>::value_at(size_t index) const
 			{
 				check_index(index);
 
@@ -115,8 +202,8 @@ namespace MyCompany
 				return result;
 			}
 
-			template <typename Number>
-			void BinaryIndexedTree<Number>::add(size_t index, const Number& increment)
+			template <typename Number, typename TStorage>
+			void BinaryIndexedTree<Number, TStorage>::add(size_t index, const Number& increment)
 			{
 				check_index(index);
 
@@ -128,8 +215,94 @@ namespace MyCompany
 				} while (index < size);
 			}
 
-			template <typename Number>
-			void BinaryIndexedTree<Number>::check_index(const size_t index) const
+			template <typename Number, typename TStorage>
+			size_t BinaryIndexedTree<Number, TStorage>::lower_bound(const Number& prefixSum) const
+			{
+				const auto size = _Data.size();
+
+				size_t step = 1;
+				while ((step << 1) < size)
+				{
+					step <<= 1;
+				}
+
+				//The "position" is the largest index known to have the prefix sum
+				// less than the "prefixSum", and the "remaining" is the difference.
+				size_t position = 0;
+				auto remaining = prefixSum;
+				for (; 0 != step; step >>= 1)
+				{
+					const auto next = position + step;
+					if (next < size && _Data[next] < remaining)
+					{
+						position = next;
+						remaining -= _Data[next];
+					}
+				}
+
+				return position + InitialIndex;
+			}
+
+			template <typename Number, typename TStorage>
+			void BinaryIndexedTree<Number, TStorage>::add(
+				const std::vector<std::pair<size_t, Number>>& increments)
+			{
+				for (const auto& increment : increments)
+				{
+					check_index(increment.first);
+				}
+
+				const auto size = _Data.size();
+
+				size_t depth = 1;
+				while ((size_t(1) << depth) < size)
+				{
+					++depth;
+				}
+
+				if (size <= increments.size() * depth)
+				{//Dense: rebuild the tree in place, in two linear passes.
+					restore_values();
+
+					for (const auto& increment : increments)
+					{
+						_Data[increment.first] += increment.second;
+					}
+
+					build_from_values();
+					return;
+				}
+
+				//Sparse: a parent index is larger than its child's,
+				// so that the smallest pending node has got all its increments.
+				using Item = std::pair<size_t, Number>;
+				std::priority_queue<Item, std::vector<Item>, std::greater<Item>> pending(
+					increments.begin(), increments.end());
+
+				while (!pending.empty())
+				{
+					const auto index = pending.top().first;
+					auto sum = pending.top().second;
+					pending.pop();
+
+					while (!pending.empty() && index == pending.top().first)
+					{
+						sum += pending.top().second;
+						pending.pop();
+					}
+
+					_Data[index] += sum;
+
+					const auto parent = index + (index & (0 - index));
+					if (parent < size)
+					{
+						pending.emplace(parent, sum);
+					}
+				}
+			}
+
+			template <typename Number, typename TStorage>
+			void BinaryIndexedTree<Number, TStorage>::check_index(const size_t index) const
 			{
 				if (0 == index || _Data.size() <= index)
 				{
@@ -140,6 +313,36 @@ namespace MyCompany
 					StreamUtilities::ThrowException<std::out_of_range>(ss);
 				}
 			}
+
+			template <typename Number, typename TStorage>
+			void BinaryIndexedTree<Number, TStorage>::build_from_values()
+			{
+				const auto size = _Data.size();
+				for (auto index = InitialIndex; index < size; ++index)
+				{
+					const auto parent = index + (index & (0 - index));
+					if (parent < size)
+					{
+						_Data[parent] += _Data[index];
+					}
+				}
+			}
+
+			template <typename Number, typename TStorage>
+			void BinaryIndexedTree<Number, TStorage>::restore_values()
+			{
+				//Going down, a node is still complete, when it is subtracted from its parent,
+				// as its own children have smaller indexes.
+				const auto size = _Data.size();
+				for (auto index = size - 1; InitialIndex <= index; --index)
+				{
+					const auto parent = index + (index & (0 - index));
+					if (parent < size)
+					{
+						_Data[parent] -= _Data[index];
+					}
+				}
+			}
 		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <stdexcept>
+#include "BinaryIndexedTree.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The same API as the BinaryIndexedTree, but for the sizes far beyond the cache.
+			//
+			//The slots are split into the blocks of the "BlockSize" slots,
+			// and a BinaryIndexedTree is kept over the block totals only.
+			//A block stores the running sums from its beginning,
+			// so that a prefix sum is a walk in the small tree plus one read.
+			//An add changes the running sums from the index to the block end:
+			// adjacent, one or two cache lines, by a loop the compiler vectorizes;
+			// then it walks up the small tree.
+			//
+			//Thus the tree, being "BlockSize" times smaller, has its upper levels cached,
+			// and a walk makes log2(BlockSize) fewer dependent memory reads.
+			//
+			//The trade-off: an add touches the block sums besides the small tree,
+			// while the low levels of the plain tree share the cache lines.
+			//At 10^8 slots (BinaryIndexedTreeBenchmark --layout-max-slots 100000000), Mops/s:
+			// the plain tree: get 6.4-7.8, add 4.5-5.2;
+			// BlockSize 16: get 5.8-8.7, add 3.0-3.5;
+			// BlockSize 64: get 7.3-8.6, add 2.4-2.7.
+			//So use it only when the sums dominate the adds; otherwise prefer the BinaryIndexedTree.
+			//
+			//Note: The indexes start from 1.
+			template <typename Number, size_t BlockSize = 16>
+			class BlockedBinaryIndexedTree final
+			{
+				static_assert(0 < BlockSize, "The BlockSize must be positive.");
+
+				//The sum of the slots from the block beginning to "i" is at [i], the [0] is unused.
+				std::vector<Number> _Sums;
+
+				//The block "b" (from 0) is at the index b + 1.
+				BinaryIndexedTree<Number> _Blocks;
+
+			public:
+
+				static constexpr size_t InitialIndex = 1;
+
+				explicit BlockedBinaryIndexedTree(size_t initialSize);
+
+				//The values [begin, end) are put at the indexes from 1 in O(N).
+				template <typename TIterator>
+				BlockedBinaryIndexedTree(TIterator begin, TIterator end);
+
+				//Return the maximum supported index.
+				inline size_t max_index() const
+				{
+					return _Sums.size() - InitialIndex;
+				}
+
+				//When "leftInclusive" is ether 0 or 1,
+				// the sum is taken from the beginning to the "rightInclusive".
+				//Otherwise, the returned sum is taken between indexes inclusively.
+				Number get(size_t leftInclusive, size_t rightInclusive) const;
+
+				//Return the sum from 1 to the "index".
+				Number get(size_t index) const;
+
+				//Return the scalar value at "index" in O(1).
+				Number value_at(size_t index) const;
+
+				void add(size_t index, const Number& increment = Number(1));
+
+			private:
+
+				void check_index(const size_t index) const;
+
+				//Return the last index of the block, containing the "index".
+				size_t block_end(const size_t index) const;
+
+				static size_t block_count(const size_t size);
+			};
+
+			template <typename Number, size_t BlockSize>
+			BlockedBinaryIndexedTree<Number, BlockSize>::BlockedBinaryIndexedTree(size_t size)
+				: _Sums(size <= 1
+					? 2 //Use 2 to generate the proper exception in the "check_index()".
+					: size + InitialIndex),
+				_Blocks(block_count(_Sums.size() - InitialIndex))
+			{
+			}
+
+			template <typename Number, size_t BlockSize>
+			template <typename TIterator>
+			BlockedBinaryIndexedTree<Number, BlockSize>::BlockedBinaryIndexedTree(
+				TIterator begin, TIterator end)
+				: BlockedBinaryIndexedTree(static_cast<size_t>(std::distance(begin, end)))
+			{
+				std::vector<Number> totals(block_count(_Sums.size() - InitialIndex));
+				for (auto index = InitialIndex; begin != end; ++begin, ++index)
+				{
+					auto& total = totals[(index - InitialIndex) / BlockSize];
+					total += *begin;
+					_Sums[index] = total;
+				}
+
+				_Blocks = BinaryIndexedTree<Number>(totals.begin(), totals.end());
+			}
+
+			template <typename Number, size_t BlockSize>
+			Number BlockedBinaryIndexedTree<Number, BlockSize>::get(
+				size_t leftInclusive, size_t rightInclusive) const
+			{
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << (_Sums.size()) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				const auto result = leftInclusive <= InitialIndex
+					? get(rightInclusive)
+					: static_cast<Number>(get(rightInclusive) - get(leftInclusive - InitialIndex));
+				return result;
+			}
+
+			template <typename Number, size_t BlockSize>
+			Number BlockedBinaryIndexedTree<Number, BlockSize>::get(size_t index) const
+			{
+				check_index(index);
+
+				const auto block = (index - InitialIndex) / BlockSize;
+				auto result = _Sums[index];
+				if (0 < block)
+				{
+					result += _Blocks.get(block);
+				}
+
+				return result;
+			}
+
+			template <typename Number, size_t BlockSize>
+			Number BlockedBinaryIndexedTree<Number, BlockSize>::value_at(size_t index) const
+			{
+				check_index(index);
+
+				const auto result = 0 == (index - InitialIndex) % BlockSize
+					? _Sums[index]
+					: static_cast<Number>(_Sums[index] - _Sums[index - 1]);
+				return result;
+			}
+
+			template <typename Number, size_t BlockSize>
+			void BlockedBinaryIndexedTree<Number, BlockSize>::add(size_t index, const Number& increment)
+			{
+				check_index(index);
+
+				const auto sums = _Sums.data();
+				const auto last = block_end(index);
+				for (auto slot = index; slot <= last; ++slot)
+				{
+					sums[slot] += increment;
+				}
+
+				_Blocks.add((index - InitialIndex) / BlockSize + InitialIndex, increment);
+			}
+
+			template <typename Number, size_t BlockSize>
+			void BlockedBinaryIndexedTree<Number, BlockSize>::check_index(const size_t index) const
+			{
+				if (0 == index || _Sums.size() <= index)
+				{
+					std::ostringstream ss;
+					ss << "The index (" << index
+						<< ") must be between " << InitialIndex
+						<< " and " << (_Sums.size() - InitialIndex) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+			}
+
+			template <typename Number, size_t BlockSize>
+			size_t BlockedBinaryIndexedTree<Number, BlockSize>::block_end(const size_t index) const
+			{
+				const auto end = ((index - InitialIndex) / BlockSize + 1) * BlockSize;
+				const auto result = std::min(end, _Sums.size() - InitialIndex);
+				return result;
+			}
+
+			template <typename Number, size_t BlockSize>
+			size_t BlockedBinaryIndexedTree<Number, BlockSize>::block_count(const size_t size)
+			{
+				const auto result = (size + BlockSize - 1) / BlockSize;
+				return result;
+			}
+		}
+	}
+}
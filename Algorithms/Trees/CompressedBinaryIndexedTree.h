@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include "BinaryIndexedTree.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The BinaryIndexedTree over the keys, known in advance, e.g. the timestamps of a batch,
+			// which may be anywhere in the 64-bit range.
+			//The keys are sorted once, and a key is replaced by its rank:
+			// the memory is O(K) for K distinct keys, an operation is O(log(K)).
+			//
+			//A sum may be asked for any key, while an add must use one of the known keys.
+			//See the SparseBinaryIndexedTree, when the keys are not known in advance.
+			template <typename Number, typename Key = std::uint64_t>
+			class CompressedBinaryIndexedTree final
+			{
+				//Sorted, distinct.
+				std::vector<Key> _Keys;
+
+				//The key _Keys[i] is at the index i + 1.
+				BinaryIndexedTree<Number> _Tree;
+
+			public:
+
+				//The "keys" may repeat, and be in any order.
+				explicit CompressedBinaryIndexedTree(std::vector<Key> keys);
+
+				template <typename TIterator>
+				CompressedBinaryIndexedTree(TIterator begin, TIterator end);
+
+				//Return the number of distinct keys.
+				inline size_t key_count() const
+				{
+					return _Keys.size();
+				}
+
+				//Return the sum over the keys between "leftInclusive" and "rightInclusive".
+				Number get(const Key& leftInclusive, const Key& rightInclusive) const;
+
+				//Return the sum over the keys, not exceeding the "key".
+				Number get(const Key& key) const;
+
+				void add(const Key& key, const Number& increment = Number(1));
+
+			private:
+
+				//Return the number of keys, not exceeding the "key".
+				size_t rank(const Key& key) const;
+
+				static std::vector<Key> sort_unique(std::vector<Key>&& keys);
+			};
+
+			template <typename Number, typename Key>
+			CompressedBinaryIndexedTree<Number, Key>::CompressedBinaryIndexedTree(
+				std::vector<Key> keys)
+				: _Keys(sort_unique(std::move(keys))),
+				_Tree(_Keys.size())
+			{
+			}
+
+			template <typename Number, typename Key>
+			template <typename TIterator>
+			CompressedBinaryIndexedTree<Number, Key>::CompressedBinaryIndexedTree(
+				TIterator begin, TIterator end)
+				: CompressedBinaryIndexedTree(std::vector<Key>(begin, end))
+			{
+			}
+
+			template <typename Number, typename Key>
+			Number CompressedBinaryIndexedTree<Number, Key>::get(
+				const Key& leftInclusive, const Key& rightInclusive) const
+			{
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << _Keys.size() << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				const auto right = rank(rightInclusive);
+				const auto left = static_cast<size_t>(
+					std::lower_bound(_Keys.begin(), _Keys.end(), leftInclusive) - _Keys.begin());
+				if (right <= left)
+				{
+					return Number();
+				}
+
+				const auto result = _Tree.get(left + 1, right);
+				return result;
+			}
+
+			template <typename Number, typename Key>
+			Number CompressedBinaryIndexedTree<Number, Key>::get(const Key& key) const
+			{
+				const auto index = rank(key);
+				const auto result = 0 == index ? Number() : _Tree.get(index);
+				return result;
+			}
+
+			template <typename Number, typename Key>
+			void CompressedBinaryIndexedTree<Number, Key>::add(const Key& key, const Number& increment)
+			{
+				const auto index = rank(key);
+				if (0 == index || !(_Keys[index - 1] == key))
+				{
+					std::ostringstream ss;
+					ss << "The key (" << key << ") must be one of the "
+						<< _Keys.size() << " keys, given to the constructor.";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+
+				_Tree.add(index, increment);
+			}
+
+			template <typename Number, typename Key>
+			size_t CompressedBinaryIndexedTree<Number, Key>::rank(const Key& key) const
+			{
+				const auto result = static_cast<size_t>(
+					std::upper_bound(_Keys.begin(), _Keys.end(), key) - _Keys.begin());
+				return result;
+			}
+
+			template <typename Number, typename Key>
+			std::vector<Key> CompressedBinaryIndexedTree<Number, Key>::sort_unique(
+				std::vector<Key>&& keys)
+			{
+				std::sort(keys.begin(), keys.end());
+				keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+				keys.shrink_to_fit();
+				return std::move(keys);
+			}
+		}
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <type_traits>
+#include <vector>
+#include <stdexcept>
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The BinaryIndexedTree, which many threads can "add" to at the same time without a lock:
+			// each node on the path is updated by a relaxed atomic fetch-add.
+			//
+			//The sums are best-effort while there are concurrent adds.
+			//A prefix sum path and an add path share at most one node,
+			// so that a prefix sum includes an add either whole or not at all;
+			// but a sum between two indexes is two prefix sums, which may see different adds.
+			//See the ShardedBinaryIndexedTree for the consistent sums.
+			//
+			//Note: The indexes start from 1.
+			template <typename Number>
+			class ConcurrentBinaryIndexedTree final
+			{
+				static_assert(std::is_integral<Number>::value,
+					"The Number must be integral to have the atomic fetch_add.");
+
+				std::vector<std::atomic<Number>> _Data;
+
+			public:
+
+				static constexpr size_t InitialIndex = 1;
+
+				explicit ConcurrentBinaryIndexedTree(size_t initialSize);
+
+				//Return the maximum supported index.
+				inline size_t max_index() const
+				{
+					return _Data.size() - InitialIndex;
+				}
+
+				//When "leftInclusive" is ether 0 or 1,
+				// the sum is taken from the beginning to the "rightInclusive".
+				//Otherwise, the returned sum is taken between indexes inclusively.
+				Number get(size_t leftInclusive, size_t rightInclusive) const;
+
+				//Return the sum from 1 to the "index".
+				Number get(size_t index) const;
+
+				void add(size_t index, const Number& increment = Number(1));
+
+			private:
+
+				void check_index(const size_t index) const;
+			};
+
+			template <typename Number>
+			ConcurrentBinaryIndexedTree<Number>::ConcurrentBinaryIndexedTree(size_t size)
+				: _Data(size <= 1
+					? 2 //Use 2 to generate the proper exception in the "check_index()".
+					: size + InitialIndex)
+			{
+				for (auto& node : _Data)
+				{
+					node.store(Number(), std::memory_order_relaxed);
+				}
+			}
+
+			template <typename Number>
+			Number ConcurrentBinaryIndexedTree<Number>::get(
+				size_t leftInclusive, size_t rightInclusive) const
+			{
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << (_Data.size()) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				const auto result = leftInclusive <= InitialIndex
+					? get(rightInclusive)
+					: static_cast<Number>(get(rightInclusive) - get(leftInclusive - InitialIndex));
+				return result;
+			}
+
+			template <typename Number>
+			Number ConcurrentBinaryIndexedTree<Number>::get(size_t index) const
+			{
+				check_index(index);
+
+				Number result{};
+				do
+				{
+					result += _Data[index].load(std::memory_order_relaxed);
+					index &= index - 1; //Remove the right-most 1-bit.
+				} while (0 != index);
+
+				return result;
+			}
+
+			template <typename Number>
+			void ConcurrentBinaryIndexedTree<Number>::add(size_t index, const Number& increment)
+			{
+				check_index(index);
+
+				const auto size = _Data.size();
+				do
+				{
+					_Data[index].fetch_add(increment, std::memory_order_relaxed);
+					index += index & (0 - index); //Add the right-most 1-bit.
+				} while (index < size);
+			}
+
+			template <typename Number>
+			void ConcurrentBinaryIndexedTree<Number>::check_index(const size_t index) const
+			{
+				if (0 == index || _Data.size() <= index)
+				{
+					std::ostringstream ss;
+					ss << "The index (" << index
+						<< ") must be between " << InitialIndex
+						<< " and " << (_Data.size() - InitialIndex) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,491 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include "../MemoryMappedFile.h"
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The nodes of a BinaryIndexedTree in a memory mapped file,
+			// so that a tree can outgrow the RAM, and be reopened after a restart in no time:
+			//  using Tree = BinaryIndexedTree<long long, MappedBinaryIndexedTreeStorage<long long>>;
+			//  Tree tree(AdoptNodes, MappedBinaryIndexedTreeStorage<long long>("counters.bit", size));
+			//  ..
+			//  tree.flush();
+			//
+			//The file layout, in the native byte order:
+			// - The header page: two Header slots, at 0 and 512; the newer valid one is used.
+			// - The nodes: Number[NodeCount], the [0] being unused, from the offset 4096.
+			// - The redo region: the Records of the last checkpoint, which grows as needed.
+			//
+			//The nodes are split into the blocks of 4096 bytes.
+			//The mapped nodes are never written between the checkpoints:
+			// the first write to a block copies it to the RAM, and the dirty copy is used till the "flush()".
+			//Thus the file always has the last checkpoint, even after a crash,
+			// but the dirty blocks take the RAM, and must be flushed from time to time.
+			//
+			//The "flush()" makes a checkpoint of the dirty blocks only:
+			// 1) The dirty blocks, with a checksum each, are written to the redo region.
+			// 2) The header with the next generation and the record count is written to the other slot:
+			//  this is the commit, as the slot with a wrong header checksum is ignored.
+			// 3) The blocks are copied to the nodes.
+			// 4) The header with the next generation and no records is written.
+			//Opening the file checks the header checksum, and, when there are records,
+			// replays them, having checked their checksums: the nodes are never scanned.
+			//The changes after the last "flush()" are lost, as is the case after a crash.
+			template <typename Number>
+			class MappedBinaryIndexedTreeStorage final
+			{
+				static_assert(std::is_trivially_copyable<Number>::value,
+					"The Number must be trivially copyable to be stored in a file.");
+
+			public:
+
+				//Open the file, creating it when missing.
+				//The "maxIndex" of an existing file must be either 0 or the same as saved.
+				MappedBinaryIndexedTreeStorage(const std::string& path, size_t maxIndex);
+
+				MappedBinaryIndexedTreeStorage(MappedBinaryIndexedTreeStorage&& other) = default;
+				MappedBinaryIndexedTreeStorage& operator = (MappedBinaryIndexedTreeStorage&& other) = default;
+
+				inline size_t size() const
+				{
+					return _Size;
+				}
+
+				inline const Number& operator[](const size_t index) const
+				{
+					const auto slot = _DirtySlots[index / BlockNodes];
+					return 0 == slot
+						? _Data[index]
+						: _Dirty[slot - 1].second[index % BlockNodes];
+				}
+
+				//The block of the node becomes dirty.
+				inline Number& operator[](const size_t index)
+				{
+					const auto block = index / BlockNodes;
+					const auto slot = _DirtySlots[block];
+					const auto nodes = 0 == slot ? MakeDirty(block) : _Dirty[slot - 1].second.get();
+					return nodes[index % BlockNodes];
+				}
+
+				//Return the number of the blocks, changed after the last checkpoint.
+				inline size_t dirty_block_count() const
+				{
+					return _Dirty.size();
+				}
+
+				//Make a checkpoint, and wait till it is on the disk.
+				void flush();
+
+			private:
+
+				struct Header final
+				{
+					char Magic[8];
+					std::uint64_t Version;
+					std::uint64_t ElementSize;
+					//'i' for the signed integers, 'u' for the unsigned ones, 'f' for the floating point.
+					std::uint64_t ElementKind;
+					std::uint64_t NodeCount;
+					//The slot is the generation % 2.
+					std::uint64_t Generation;
+					//The records to be replayed.
+					std::uint64_t RecordCount;
+					//Of the fields above.
+					std::uint64_t Checksum;
+				};
+
+				//A block copy in the redo region, followed by the BlockSize bytes.
+				struct Record final
+				{
+					std::uint64_t Block;
+					//Of the block number and bytes.
+					std::uint64_t Checksum;
+				};
+
+				static constexpr std::uint64_t CurrentVersion = 2;
+
+				//A header slot is written in one disk sector.
+				static constexpr size_t SlotSize = 512;
+				static constexpr size_t HeaderSize = 4096;
+
+				static constexpr size_t BlockSize = 4096;
+				static constexpr size_t BlockNodes = BlockSize / sizeof(Number);
+				static constexpr size_t RecordSize = sizeof(Record) + BlockSize;
+
+				static_assert(sizeof(Header) <= SlotSize, "The Header must fit the SlotSize.");
+				static_assert(0 < BlockNodes && 0 == BlockSize % sizeof(Number),
+					"The Number size must divide the BlockSize.");
+
+				static const char* Magic()
+				{
+					return "FENWICKT";
+				}
+
+				std::string _Path;
+				MemoryMappedFile _File;
+				Number* _Data;
+				size_t _Size;
+
+				Header _Header;
+
+				//The index + 1 in the "_Dirty" of a block, or 0 for a clean one.
+				std::vector<size_t> _DirtySlots;
+				//The block and its nodes; the copies do not move till the "flush()".
+				using DirtyBlock = std::pair<size_t, std::unique_ptr<Number[]>>;
+				std::vector<DirtyBlock> _Dirty;
+
+				void Create(const size_t maxIndex);
+
+				void Validate(const size_t maxIndex);
+
+				//Write the dirty blocks to the nodes of the mapped file.
+				void Replay();
+
+				Number* MakeDirty(const size_t block);
+
+				//Return the number of nodes in the "block".
+				size_t block_nodes(const size_t block) const;
+
+				//The records follow the nodes, aligned to 8 bytes.
+				size_t redo_offset() const;
+
+				size_t record_capacity() const;
+
+				//Map the file again, having the room for at least "recordCount" records.
+				void Reserve(const size_t recordCount);
+
+				//Write the "_Header" with the next generation to its slot, and wait till it is on the disk.
+				void Commit(const std::uint64_t recordCount);
+
+				//Return whether the slot has a valid header, and copy it to the "header".
+				bool ReadSlot(const size_t slot, Header& header) const;
+
+				void ThrowInvalidFile() const;
+
+				//FNV-1a: cheap, and sensitive to the byte order.
+				static std::uint64_t Checksum(const void* data, const size_t byteCount,
+					std::uint64_t result = 0xCBF29CE484222325ull);
+
+				static std::uint64_t ElementKind();
+			};
+
+			template <typename Number>
+			MappedBinaryIndexedTreeStorage<Number>::MappedBinaryIndexedTreeStorage(
+				const std::string& path, size_t maxIndex)
+				: _Path(path),
+				_File(path, MemoryMappedFile::Mode::ReadWrite),
+				_Data(nullptr),
+				_Size(0),
+				_Header()
+			{
+				if (0 == _File.size())
+				{
+					Create(maxIndex);
+				}
+				else
+				{
+					Validate(maxIndex);
+				}
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::flush()
+			{
+				if (_Dirty.empty())
+				{
+					return;
+				}
+
+				Reserve(_Dirty.size());
+
+				const auto redo = _File.data() + redo_offset();
+				for (size_t index = 0; index < _Dirty.size(); ++index)
+				{
+					const auto& dirty = _Dirty[index];
+					const auto bytes = block_nodes(dirty.first) * sizeof(Number);
+
+					Record record;
+					record.Block = dirty.first;
+					record.Checksum = Checksum(dirty.second.get(), bytes,
+						Checksum(&record.Block, sizeof record.Block));
+
+					const auto destination = redo + index * RecordSize;
+					std::memcpy(destination, &record, sizeof record);
+					std::memcpy(destination + sizeof record, dirty.second.get(), bytes);
+				}
+
+				_File.Flush(redo_offset(), _Dirty.size() * RecordSize);
+				Commit(_Dirty.size());
+
+				Replay();
+				Commit(0);
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::Create(const size_t maxIndex)
+			{
+				//Use 2 to generate the proper exception in the "check_index()".
+				const auto nodeCount = maxIndex <= 1 ? size_t(2) : maxIndex + 1;
+
+				_File = MemoryMappedFile(_Path, MemoryMappedFile::Mode::ReadWrite,
+					HeaderSize + nodeCount * sizeof(Number));
+
+				//The new bytes are zeros, as are the nodes of an empty tree.
+				std::memcpy(_Header.Magic, Magic(), sizeof _Header.Magic);
+				_Header.Version = CurrentVersion;
+				_Header.ElementSize = sizeof(Number);
+				_Header.ElementKind = ElementKind();
+				_Header.NodeCount = nodeCount;
+
+				_Data = reinterpret_cast<Number*>(_File.data() + HeaderSize);
+				_Size = nodeCount;
+				_DirtySlots.assign((_Size + BlockNodes - 1) / BlockNodes, 0);
+
+				Commit(0);
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::Validate(const size_t maxIndex)
+			{
+				Header headers[2];
+				const bool isValid[2] = { ReadSlot(0, headers[0]), ReadSlot(1, headers[1]) };
+				if (!isValid[0] && !isValid[1])
+				{
+					ThrowInvalidFile();
+				}
+
+				_Header = !isValid[1] || (isValid[0] && headers[1].Generation < headers[0].Generation)
+					? headers[0] : headers[1];
+
+				const auto isBadHeader = CurrentVersion != _Header.Version
+					|| sizeof(Number) != _Header.ElementSize
+					|| ElementKind() != _Header.ElementKind
+					|| _Header.NodeCount < 2
+					|| _File.size() < HeaderSize + _Header.NodeCount * sizeof(Number);
+				if (isBadHeader)
+				{
+					ThrowInvalidFile();
+				}
+
+				_Data = reinterpret_cast<Number*>(_File.data() + HeaderSize);
+				_Size = static_cast<size_t>(_Header.NodeCount);
+				_DirtySlots.assign((_Size + BlockNodes - 1) / BlockNodes, 0);
+
+				if (0 != maxIndex && maxIndex + 1 != _Size)
+				{
+					std::ostringstream ss;
+					ss << "The file '" << _Path << "' has the max index " << (_Size - 1)
+						<< ", but " << maxIndex << " is required.";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+
+				if (0 == _Header.RecordCount)
+				{
+					return;
+				}
+
+				//The checkpoint has been committed, but maybe not copied to the nodes.
+				if (record_capacity() < _Header.RecordCount)
+				{
+					ThrowInvalidFile();
+				}
+
+				const auto redo = _File.data() + redo_offset();
+				for (size_t index = 0; index < _Header.RecordCount; ++index)
+				{
+					const auto source = redo + index * RecordSize;
+
+					Record record;
+					std::memcpy(&record, source, sizeof record);
+
+					const auto isBadRecord = _DirtySlots.size() <= record.Block
+						|| record.Checksum != Checksum(source + sizeof record,
+							block_nodes(static_cast<size_t>(record.Block)) * sizeof(Number),
+							Checksum(&record.Block, sizeof record.Block));
+					if (isBadRecord)
+					{
+						std::ostringstream ss;
+						ss << "The file '" << _Path << "' has the damaged record " << index
+							<< " of the last checkpoint, and must be rebuilt.";
+						StreamUtilities::ThrowException(ss);
+					}
+
+					const auto nodes = MakeDirty(static_cast<size_t>(record.Block));
+					std::memcpy(nodes, source + sizeof record,
+						block_nodes(static_cast<size_t>(record.Block)) * sizeof(Number));
+				}
+
+				Replay();
+				Commit(0);
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::Replay()
+			{
+				//Sorted, so that the consecutive blocks are flushed at once,
+				// rather than all the nodes, most of them being clean.
+				std::sort(_Dirty.begin(), _Dirty.end(),
+					[](const DirtyBlock& left, const DirtyBlock& right)
+					{
+						return left.first < right.first;
+					});
+
+				for (size_t begin = 0; begin < _Dirty.size();)
+				{
+					auto end = begin;
+					do
+					{
+						const auto& dirty = _Dirty[end];
+						std::memcpy(_Data + dirty.first * BlockNodes, dirty.second.get(),
+							block_nodes(dirty.first) * sizeof(Number));
+
+						_DirtySlots[dirty.first] = 0;
+						++end;
+					} while (end < _Dirty.size() && _Dirty[end - 1].first + 1 == _Dirty[end].first);
+
+					const auto first = _Dirty[begin].first;
+					const auto last = _Dirty[end - 1].first;
+					_File.Flush(HeaderSize + first * BlockSize,
+						(last - first) * BlockSize + block_nodes(last) * sizeof(Number));
+
+					begin = end;
+				}
+
+				_Dirty.clear();
+			}
+
+			template <typename Number>
+			Number* MappedBinaryIndexedTreeStorage<Number>::MakeDirty(const size_t block)
+			{
+				const auto count = block_nodes(block);
+
+				std::unique_ptr<Number[]> nodes(new Number[BlockNodes]);
+				std::memcpy(nodes.get(), _Data + block * BlockNodes, count * sizeof(Number));
+
+				_Dirty.emplace_back(block, std::move(nodes));
+				_DirtySlots[block] = _Dirty.size();
+				return _Dirty.back().second.get();
+			}
+
+			template <typename Number>
+			size_t MappedBinaryIndexedTreeStorage<Number>::block_nodes(const size_t block) const
+			{
+				const auto result = std::min(BlockNodes, _Size - block * BlockNodes);
+				return result;
+			}
+
+			template <typename Number>
+			size_t MappedBinaryIndexedTreeStorage<Number>::redo_offset() const
+			{
+				const auto end = HeaderSize + _Size * sizeof(Number);
+				const auto result = (end + 7) / 8 * 8;
+				return result;
+			}
+
+			template <typename Number>
+			size_t MappedBinaryIndexedTreeStorage<Number>::record_capacity() const
+			{
+				const auto offset = redo_offset();
+				const auto result = offset < _File.size() ? (_File.size() - offset) / RecordSize : 0;
+				return result;
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::Reserve(const size_t recordCount)
+			{
+				const auto capacity = record_capacity();
+				if (recordCount <= capacity)
+				{
+					return;
+				}
+
+				//Doubled to be remapped rarely; the old mapping is closed first.
+				const auto newCapacity = std::max(recordCount, capacity * 2);
+				{
+					const auto closed = std::move(_File);
+				}
+
+				_File = MemoryMappedFile(_Path, MemoryMappedFile::Mode::ReadWrite,
+					redo_offset() + newCapacity * RecordSize);
+				_Data = reinterpret_cast<Number*>(_File.data() + HeaderSize);
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::Commit(const std::uint64_t recordCount)
+			{
+				++_Header.Generation;
+				_Header.RecordCount = recordCount;
+				_Header.Checksum = Checksum(&_Header, offsetof(Header, Checksum));
+
+				std::memcpy(_File.data() + (_Header.Generation % 2) * SlotSize, &_Header, sizeof _Header);
+				_File.Flush(0, HeaderSize);
+			}
+
+			template <typename Number>
+			bool MappedBinaryIndexedTreeStorage<Number>::ReadSlot(
+				const size_t slot, Header& header) const
+			{
+				if (_File.size() < HeaderSize)
+				{
+					return false;
+				}
+
+				std::memcpy(&header, _File.data() + slot * SlotSize, sizeof header);
+
+				const auto result = 0 == std::memcmp(header.Magic, Magic(), sizeof header.Magic)
+					&& slot == header.Generation % 2
+					&& header.Checksum == Checksum(&header, offsetof(Header, Checksum));
+				return result;
+			}
+
+			template <typename Number>
+			void MappedBinaryIndexedTreeStorage<Number>::ThrowInvalidFile() const
+			{
+				std::ostringstream ss;
+				ss << "The file '" << _Path << "' is not a valid tree of "
+					<< sizeof(Number) << "-byte '" << static_cast<char>(ElementKind())
+					<< "' numbers, size=" << _File.size() << ".";
+				StreamUtilities::ThrowException(ss);
+			}
+
+			template <typename Number>
+			std::uint64_t MappedBinaryIndexedTreeStorage<Number>::Checksum(
+				const void* data, const size_t byteCount, std::uint64_t result)
+			{
+				constexpr std::uint64_t prime = 0x100000001B3ull;
+
+				const auto bytes = static_cast<const unsigned char*>(data);
+				for (size_t offset = 0; offset < byteCount; ++offset)
+				{
+					result = (result ^ bytes[offset]) * prime;
+				}
+
+				return result;
+			}
+
+			template <typename Number>
+			std::uint64_t MappedBinaryIndexedTreeStorage<Number>::ElementKind()
+			{
+				const auto result = std::is_floating_point<Number>::value ? 'f'
+					: std::is_signed<Number>::value ? 'i' : 'u';
+				return static_cast<std::uint64_t>(result);
+			}
+		}
+	}
+}
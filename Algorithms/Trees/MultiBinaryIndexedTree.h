@@ -0,0 +1,242 @@
+#pragma once
+#include <array>
+#include <type_traits>
+#include <vector>
+#include <stdexcept>
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The BinaryIndexedTree of several dimensions, e.g. 2 for a matrix:
+			// adding a number to a cell, and the sum over a box of cells,
+			// both run in O(log(N1) * log(N2) * .. * log(N_Dimensions)).
+			//
+			//The nodes are in one array in the row-major order:
+			// the last dimension is contiguous, the strides are computed once.
+			//The loop of each dimension is a separate function,
+			// so that a compiler can unroll and inline them all.
+			//
+			//Note: The indexes start from 1.
+			template <typename Number, size_t Dimensions = 2>
+			class MultiBinaryIndexedTree final
+			{
+				static_assert(0 < Dimensions, "The Dimensions must be positive.");
+
+			public:
+
+				using Index = std::array<size_t, Dimensions>;
+
+				static constexpr size_t InitialIndex = 1;
+
+				//The "sizes" are the maximum indexes of the dimensions.
+				explicit MultiBinaryIndexedTree(const Index& sizes);
+
+				//Return the maximum supported index of the "dimension".
+				inline size_t max_index(const size_t dimension) const
+				{
+					return _Sizes[dimension] - InitialIndex;
+				}
+
+				//Return the sum over the box between the corners inclusively.
+				//When a "leftInclusive" item is ether 0 or 1,
+				// the box starts at the beginning of that dimension.
+				Number get(const Index& leftInclusive, const Index& rightInclusive) const;
+
+				//Return the sum over the box from (1, .., 1) to the "index".
+				Number get(const Index& index) const;
+
+				void add(const Index& index, const Number& increment = Number(1));
+
+			private:
+
+				template <size_t Dimension>
+				using DimensionTag = std::integral_constant<size_t, Dimension>;
+
+				//The number of nodes in each dimension, the max index + 1.
+				Index _Sizes;
+				Index _Strides;
+				std::vector<Number> _Data;
+
+				void check_index(const Index& index) const;
+
+				template <size_t Dimension>
+				Number sum(const Index& index, const size_t offset, DimensionTag<Dimension>) const;
+
+				inline Number sum(const Index&, const size_t offset, DimensionTag<Dimensions>) const
+				{
+					return _Data[offset];
+				}
+
+				template <size_t Dimension>
+				void add(const Index& index, const size_t offset,
+					const Number& increment, DimensionTag<Dimension>);
+
+				inline void add(const Index&, const size_t offset,
+					const Number& increment, DimensionTag<Dimensions>)
+				{
+					_Data[offset] += increment;
+				}
+
+				static Index NodeCounts(const Index& sizes);
+			};
+
+			template <typename Number, size_t Dimensions>
+			MultiBinaryIndexedTree<Number, Dimensions>::MultiBinaryIndexedTree(const Index& sizes)
+				: _Sizes(NodeCounts(sizes))
+			{
+				size_t total = 1;
+				for (auto dimension = Dimensions; 0 < dimension--;)
+				{
+					_Strides[dimension] = total;
+					total *= _Sizes[dimension];
+				}
+
+				_Data.resize(total);
+			}
+
+			template <typename Number, size_t Dimensions>
+			Number MultiBinaryIndexedTree<Number, Dimensions>::get(
+				const Index& leftInclusive, const Index& rightInclusive) const
+			{
+				check_index(rightInclusive);
+#ifdef _DEBUG
+				for (size_t dimension = 0; dimension < Dimensions; ++dimension)
+				{
+					if (rightInclusive[dimension] < leftInclusive[dimension])
+					{
+						std::ostringstream ss;
+						ss << "The rightInclusive (" << rightInclusive[dimension]
+							<< ") cannot be smaller than leftInclusive (" << leftInclusive[dimension]
+							<< ") in the dimension " << dimension << ".";
+						StreamUtilities::ThrowException<std::out_of_range>(ss);
+					}
+				}
+#endif
+				//Inclusion-exclusion over the 2^Dimensions corners:
+				// a corner, taking the "left - 1" in an odd number of dimensions, is subtracted.
+				Number result{};
+				for (size_t mask = 0; mask < (size_t(1) << Dimensions); ++mask)
+				{
+					Index corner = rightInclusive;
+					auto isEmpty = false;
+					auto isNegative = false;
+
+					for (size_t dimension = 0; dimension < Dimensions; ++dimension)
+					{
+						if (0 == (mask & (size_t(1) << dimension)))
+						{
+							continue;
+						}
+
+						if (leftInclusive[dimension] <= InitialIndex)
+						{
+							isEmpty = true;
+							break;
+						}
+
+						corner[dimension] = leftInclusive[dimension] - InitialIndex;
+						isNegative = !isNegative;
+					}
+
+					if (isEmpty)
+					{
+						continue;
+					}
+
+					const auto value = sum(corner, 0, DimensionTag<0>());
+					result = static_cast<Number>(isNegative ? result - value : result + value);
+				}
+
+				return result;
+			}
+
+			template <typename Number, size_t Dimensions>
+			Number MultiBinaryIndexedTree<Number, Dimensions>::get(const Index& index) const
+			{
+				check_index(index);
+
+				const auto result = sum(index, 0, DimensionTag<0>());
+				return result;
+			}
+
+			template <typename Number, size_t Dimensions>
+			template <size_t Dimension>
+			Number MultiBinaryIndexedTree<Number, Dimensions>::sum(
+				const Index& index, const size_t offset, DimensionTag<Dimension>) const
+			{
+				const auto stride = _Strides[Dimension];
+
+				Number result{};
+				auto current = index[Dimension];
+				do
+				{
+					result += sum(index, offset + current * stride, DimensionTag<Dimension + 1>());
+					current &= current - 1; //Remove the right-most 1-bit.
+				} while (0 != current);
+
+				return result;
+			}
+
+			template <typename Number, size_t Dimensions>
+			void MultiBinaryIndexedTree<Number, Dimensions>::add(
+				const Index& index, const Number& increment)
+			{
+				check_index(index);
+
+				add(index, 0, increment, DimensionTag<0>());
+			}
+
+			template <typename Number, size_t Dimensions>
+			template <size_t Dimension>
+			void MultiBinaryIndexedTree<Number, Dimensions>::add(
+				const Index& index, const size_t offset,
+				const Number& increment, DimensionTag<Dimension>)
+			{
+				const auto stride = _Strides[Dimension];
+				const auto size = _Sizes[Dimension];
+
+				auto current = index[Dimension];
+				do
+				{
+					add(index, offset + current * stride, increment, DimensionTag<Dimension + 1>());
+					current += current & (0 - current); //Add the right-most 1-bit.
+				} while (current < size);
+			}
+
+			template <typename Number, size_t Dimensions>
+			void MultiBinaryIndexedTree<Number, Dimensions>::check_index(const Index& index) const
+			{
+				for (size_t dimension = 0; dimension < Dimensions; ++dimension)
+				{
+					if (0 == index[dimension] || _Sizes[dimension] <= index[dimension])
+					{
+						std::ostringstream ss;
+						ss << "The index (" << index[dimension]
+							<< ") must be between " << InitialIndex
+							<< " and " << (_Sizes[dimension] - InitialIndex)
+							<< " in the dimension " << dimension << ".";
+						StreamUtilities::ThrowException<std::out_of_range>(ss);
+					}
+				}
+			}
+
+			template <typename Number, size_t Dimensions>
+			typename MultiBinaryIndexedTree<Number, Dimensions>::Index
+				MultiBinaryIndexedTree<Number, Dimensions>::NodeCounts(const Index& sizes)
+			{
+				Index result;
+				for (size_t dimension = 0; dimension < Dimensions; ++dimension)
+				{
+					//Use 2 to generate the proper exception in the "check_index()".
+					result[dimension] = sizes[dimension] <= 1 ? 2 : sizes[dimension] + InitialIndex;
+				}
+
+				return result;
+			}
+		}
+	}
+}
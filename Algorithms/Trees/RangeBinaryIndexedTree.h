@@ -0,0 +1,188 @@
+#pragma once
+#include <vector>
+#include <stdexcept>
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//Like the BinaryIndexedTree, but a number can be added to all the slots
+			// between i and j at once; both that and the sum run in O(log(N)).
+			//
+			//Two Fenwick trees are kept: after adding "v" to the slots [i, j],
+			// the slope tree has +v at i, and -v at j + 1,
+			// the offset tree has +v*(i - 1) at i, and -v*j at j + 1.
+			//Then the sum from 1 to k is Slope(k)*k - Offset(k),
+			// where Slope(k) and Offset(k) are the prefix sums of the trees.
+			//A node keeps both the trees values, so that a walk reads one array.
+			//
+			//Note: The indexes start from 1.
+			template <typename Number>
+			class RangeBinaryIndexedTree final
+			{
+				struct Node final
+				{
+					Number Slope;
+					Number Offset;
+				};
+
+				std::vector<Node> _Data;
+
+			public:
+
+				static constexpr size_t InitialIndex = 1;
+
+				explicit RangeBinaryIndexedTree(size_t initialSize);
+
+				//Return the maximum supported index.
+				inline size_t max_index() const
+				{
+					return _Data.size() - InitialIndex;
+				}
+
+				//When "leftInclusive" is ether 0 or 1,
+				// the sum is taken from the beginning to the "rightInclusive".
+				//Otherwise, the returned sum is taken between indexes inclusively.
+				Number get(size_t leftInclusive, size_t rightInclusive) const;
+
+				//Return the sum from 1 to the "index".
+				Number get(size_t index) const;
+
+				//Return the scalar value at "index",
+				// which is the same as get(index, index).
+				Number value_at(size_t index) const;
+
+				//Add the "increment" to the slot at the "index".
+				void add(size_t index, const Number& increment = Number(1));
+
+				//Add the "increment" to each slot between the indexes inclusively.
+				void add(size_t leftInclusive, size_t rightInclusive, const Number& increment);
+
+			private:
+
+				void check_index(const size_t index) const;
+
+				//Add to the slope and offset trees from the "index" up.
+				void add_node(size_t index, const Number& slope, const Number& offset);
+			};
+
+			template <typename Number>
+			RangeBinaryIndexedTree<Number>::RangeBinaryIndexedTree(size_t size)
+				: _Data(size <= 1
+					? 2 //Use 2 to generate the proper exception in the "check_index()".
+					: size + InitialIndex, Node{})
+			{
+			}
+
+			template <typename Number>
+			Number RangeBinaryIndexedTree<Number>::get(
+				size_t leftInclusive, size_t rightInclusive) const
+			{
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << (_Data.size()) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				const auto result = leftInclusive <= InitialIndex
+					? get(rightInclusive)
+					: static_cast<Number>(get(rightInclusive) - get(leftInclusive - InitialIndex));
+				return result;
+			}
+
+			template <typename Number>
+			Number RangeBinaryIndexedTree<Number>::get(size_t index) const
+			{
+				check_index(index);
+
+				const auto count = static_cast<Number>(index);
+
+				Number slope{};
+				Number offset{};
+				do
+				{
+					slope += _Data[index].Slope;
+					offset += _Data[index].Offset;
+					index &= index - 1; //Remove the right-most 1-bit.
+				} while (0 != index);
+
+				const auto result = static_cast<Number>(slope * count - offset);
+				return result;
+			}
+
+			template <typename Number>
+			Number RangeBinaryIndexedTree<Number>::value_at(size_t index) const
+			{
+				const auto result = get(index, index);
+				return result;
+			}
+
+			template <typename Number>
+			void RangeBinaryIndexedTree<Number>::add(size_t index, const Number& increment)
+			{
+				add(index, index, increment);
+			}
+
+			template <typename Number>
+			void RangeBinaryIndexedTree<Number>::add(
+				size_t leftInclusive, size_t rightInclusive, const Number& increment)
+			{
+				check_index(leftInclusive);
+				check_index(rightInclusive);
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << (_Data.size()) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				add_node(leftInclusive, increment,
+					static_cast<Number>(increment * static_cast<Number>(leftInclusive - InitialIndex)));
+
+				//Past the last slot, nothing is ever summed.
+				const auto next = rightInclusive + 1;
+				if (next < _Data.size())
+				{
+					add_node(next, static_cast<Number>(0 - increment),
+						static_cast<Number>(0 - increment * static_cast<Number>(rightInclusive)));
+				}
+			}
+
+			template <typename Number>
+			void RangeBinaryIndexedTree<Number>::add_node(
+				size_t index, const Number& slope, const Number& offset)
+			{
+				const auto size = _Data.size();
+				do
+				{
+					_Data[index].Slope += slope;
+					_Data[index].Offset += offset;
+					index += index & (0 - index); //Add the right-most 1-bit.
+				} while (index < size);
+			}
+
+			template <typename Number>
+			void RangeBinaryIndexedTree<Number>::check_index(const size_t index) const
+			{
+				if (0 == index || _Data.size() <= index)
+				{
+					std::ostringstream ss;
+					ss << "The index (" << index
+						<< ") must be between " << InitialIndex
+						<< " and " << (_Data.size() - InitialIndex) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+			}
+		}
+	}
+}
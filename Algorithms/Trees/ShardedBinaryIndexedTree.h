@@ -0,0 +1,325 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <stdexcept>
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The BinaryIndexedTree for many writer threads, when the sums must be consistent.
+			//
+			//A shard is a separate tree; a sum is computed in each shard, and they are added up.
+			//A writer locks any free shard, starting from the one it used before,
+			// and a new shard is created only when all the existing ones are busy.
+			//Thus there are no more shards than the concurrent writers, at most "maxShardCount",
+			// and the shards of the exited threads are reused by the new ones.
+			//The sequence and the nodes of a shard are padded by 64 bytes,
+			// so that the writers of different shards never touch the same cache lines.
+			//
+			//A shard is guarded by a sequence lock:
+			// a writer makes the sequence odd by a CAS, updates the nodes, then makes it even again;
+			// a reader retries, until the sequence is the same even number before and after.
+			//Thus a sum between two indexes in a shard includes the same adds.
+			//The shards are read one after another, so that the total
+			// is exact once the writers have stopped; until then it includes
+			// a prefix of the adds of each shard, and never decreases for non-negative adds.
+			//
+			//Note: The indexes start from 1.
+			template <typename Number>
+			class ShardedBinaryIndexedTree final
+			{
+				static_assert(std::is_integral<Number>::value,
+					"The Number must be integral to be atomic.");
+
+			public:
+
+				static constexpr size_t InitialIndex = 1;
+
+				static constexpr size_t DefaultMaxShardCount = 256;
+
+				//The "maxShardCount" limits the memory; the extra writers wait for a free shard.
+				explicit ShardedBinaryIndexedTree(size_t initialSize,
+					size_t maxShardCount = DefaultMaxShardCount);
+
+				~ShardedBinaryIndexedTree();
+
+				ShardedBinaryIndexedTree(const ShardedBinaryIndexedTree&) = delete;
+				ShardedBinaryIndexedTree& operator = (const ShardedBinaryIndexedTree&) = delete;
+
+				//Return the maximum supported index.
+				inline size_t max_index() const
+				{
+					return _Size - InitialIndex;
+				}
+
+				//Return the number of the created shards.
+				inline size_t shard_count() const
+				{
+					return std::min(_ShardCount.load(std::memory_order_acquire), _MaxShardCount);
+				}
+
+				//When "leftInclusive" is ether 0 or 1,
+				// the sum is taken from the beginning to the "rightInclusive".
+				//Otherwise, the returned sum is taken between indexes inclusively.
+				Number get(size_t leftInclusive, size_t rightInclusive) const;
+
+				//Return the sum from 1 to the "index".
+				Number get(size_t index) const;
+
+				//A shard is created when all the existing ones are being written.
+				void add(size_t index, const Number& increment = Number(1));
+
+			private:
+
+				static constexpr size_t CacheLineSize = 64;
+				static constexpr size_t PaddingNodes = (CacheLineSize + sizeof(Number) - 1) / sizeof(Number);
+
+				struct Shard final
+				{
+					char _Before[CacheLineSize];
+					//Odd while a writer holds the shard.
+					std::atomic<size_t> Sequence;
+					char _After[CacheLineSize];
+
+					//The PaddingNodes, the max index + 1 nodes, the PaddingNodes.
+					std::unique_ptr<std::atomic<Number>[]> Storage;
+
+					explicit Shard(const size_t size);
+
+					inline std::atomic<Number>* nodes() const
+					{
+						return Storage.get() + PaddingNodes;
+					}
+				};
+
+				//The nodes of a shard, the max index + 1.
+				size_t _Size;
+				size_t _MaxShardCount;
+
+				//The slots, taken by the writers, may exceed the _MaxShardCount.
+				std::atomic<size_t> _ShardCount;
+
+				//A shard is published after being created; nullptr till then.
+				std::unique_ptr<std::atomic<Shard*>[]> _Shards;
+
+				void check_index(const size_t index) const;
+
+				//Return a shard, locked by the current thread with an odd sequence.
+				Shard& lock_shard();
+
+				//Return the sum in the shard nodes between the indexes exclusively-inclusively.
+				Number sum(const std::atomic<Number>* shard,
+					size_t leftExclusive, size_t rightInclusive) const;
+			};
+
+			template <typename Number>
+			ShardedBinaryIndexedTree<Number>::Shard::Shard(const size_t size)
+				: Storage(new std::atomic<Number>[size + 2 * PaddingNodes])
+			{
+				Sequence.store(0, std::memory_order_relaxed);
+				for (size_t index = 0; index < size + 2 * PaddingNodes; ++index)
+				{
+					Storage[index].store(Number(), std::memory_order_relaxed);
+				}
+			}
+
+			template <typename Number>
+			ShardedBinaryIndexedTree<Number>::ShardedBinaryIndexedTree(
+				size_t size, size_t maxShardCount)
+				: _Size(size <= 1
+					? 2 //Use 2 to generate the proper exception in the "check_index()".
+					: size + InitialIndex),
+				_MaxShardCount(std::max(maxShardCount, size_t(1))),
+				_ShardCount(0),
+				_Shards(new std::atomic<Shard*>[_MaxShardCount])
+			{
+				for (size_t shard = 0; shard < _MaxShardCount; ++shard)
+				{
+					_Shards[shard].store(nullptr, std::memory_order_relaxed);
+				}
+
+				std::atomic_thread_fence(std::memory_order_release);
+			}
+
+			template <typename Number>
+			ShardedBinaryIndexedTree<Number>::~ShardedBinaryIndexedTree()
+			{
+				for (size_t shard = 0; shard < _MaxShardCount; ++shard)
+				{
+					delete _Shards[shard].load(std::memory_order_acquire);
+				}
+			}
+
+			template <typename Number>
+			Number ShardedBinaryIndexedTree<Number>::get(
+				size_t leftInclusive, size_t rightInclusive) const
+			{
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << _Size << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				check_index(rightInclusive);
+
+				const auto leftExclusive = leftInclusive <= InitialIndex
+					? size_t(0)
+					: leftInclusive - InitialIndex;
+
+				Number result{};
+				const auto shardCount = shard_count();
+				for (size_t index = 0; index < shardCount; ++index)
+				{
+					const auto shard = _Shards[index].load(std::memory_order_acquire);
+					if (nullptr == shard)
+					{//Being created, thus without adds.
+						continue;
+					}
+
+					const auto& sequence = shard->Sequence;
+					const auto nodes = shard->nodes();
+
+					for (;;)
+					{
+						const auto before = sequence.load(std::memory_order_acquire);
+						if (0 != (before & 1))
+						{//A writer is busy.
+							std::this_thread::yield();
+							continue;
+						}
+
+						const auto value = sum(nodes, leftExclusive, rightInclusive);
+
+						std::atomic_thread_fence(std::memory_order_acquire);
+						if (before == sequence.load(std::memory_order_relaxed))
+						{
+							result += value;
+							break;
+						}
+					}
+				}
+
+				return result;
+			}
+
+			template <typename Number>
+			Number ShardedBinaryIndexedTree<Number>::get(size_t index) const
+			{
+				const auto result = get(InitialIndex, index);
+				return result;
+			}
+
+			template <typename Number>
+			void ShardedBinaryIndexedTree<Number>::add(size_t index, const Number& increment)
+			{
+				check_index(index);
+
+				auto& shard = lock_shard();
+				auto& sequence = shard.Sequence;
+
+				//The odd sequence must be visible before any node is changed.
+				std::atomic_thread_fence(std::memory_order_release);
+
+				const auto nodes = shard.nodes();
+				do
+				{
+					const auto value = nodes[index].load(std::memory_order_relaxed);
+					nodes[index].store(static_cast<Number>(value + increment), std::memory_order_relaxed);
+					index += index & (0 - index); //Add the right-most 1-bit.
+				} while (index < _Size);
+
+				const auto locked = sequence.load(std::memory_order_relaxed);
+				sequence.store(locked + 1, std::memory_order_release);
+			}
+
+			template <typename Number>
+			Number ShardedBinaryIndexedTree<Number>::sum(const std::atomic<Number>* shard,
+				size_t leftExclusive, size_t rightInclusive) const
+			{
+				Number result{};
+				while (leftExclusive < rightInclusive)
+				{
+					result += shard[rightInclusive].load(std::memory_order_relaxed);
+					rightInclusive &= rightInclusive - 1; //Remove the right-most 1-bit.
+				}
+
+				while (rightInclusive < leftExclusive)
+				{
+					result -= shard[leftExclusive].load(std::memory_order_relaxed);
+					leftExclusive &= leftExclusive - 1;
+				}
+
+				return result;
+			}
+
+			template <typename Number>
+			void ShardedBinaryIndexedTree<Number>::check_index(const size_t index) const
+			{
+				if (0 == index || _Size <= index)
+				{
+					std::ostringstream ss;
+					ss << "The index (" << index
+						<< ") must be between " << InitialIndex
+						<< " and " << (_Size - InitialIndex) << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+			}
+
+			template <typename Number>
+			typename ShardedBinaryIndexedTree<Number>::Shard& ShardedBinaryIndexedTree<Number>::lock_shard()
+			{
+				//A thread starts from the same shard, so that its nodes stay in the thread cache.
+				static std::atomic<size_t> nextThread(0);
+				thread_local const size_t threadNumber = nextThread.fetch_add(1, std::memory_order_relaxed);
+
+				for (;;)
+				{
+					const auto shardCount = shard_count();
+					for (size_t attempt = 0; attempt < shardCount; ++attempt)
+					{
+						const auto shard = _Shards[(threadNumber + attempt) % shardCount].load(std::memory_order_acquire);
+						if (nullptr == shard)
+						{
+							continue;
+						}
+
+						auto before = shard->Sequence.load(std::memory_order_relaxed);
+						//Acquire the adds of the previous writer.
+						if (0 == (before & 1) && shard->Sequence.compare_exchange_strong(before, before + 1,
+							std::memory_order_acquire, std::memory_order_relaxed))
+						{
+							return *shard;
+						}
+					}
+
+					if (shardCount < _MaxShardCount)
+					{
+						const auto slot = _ShardCount.fetch_add(1, std::memory_order_relaxed);
+						if (slot < _MaxShardCount)
+						{
+							std::unique_ptr<Shard> shard(new Shard(_Size));
+							shard->Sequence.store(1, std::memory_order_relaxed);
+
+							_Shards[slot].store(shard.get(), std::memory_order_release);
+							return *shard.release();
+						}
+					}
+
+					//All the shards are busy.
+					std::this_thread::yield();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <stdexcept>
+#include "../StreamUtilities.h"
+
+namespace MyCompany
+{
+	namespace Algorithms
+	{
+		namespace Trees
+		{
+			//The BinaryIndexedTree over the 64-bit indexes, e.g. the user IDs,
+			// when they are not known in advance.
+			//
+			//The nodes are the same as in the dense tree, but only the touched ones exist:
+			// they are kept in an open-addressing hash table, the node index being the key.
+			//An operation visits at most 64 nodes, and an add creates at most 64 of them,
+			// so that the memory is O(A * log(max index)) for A adds to distinct indexes.
+			//A missing node is zero, thus a sum only reads the table.
+			//
+			//See the CompressedBinaryIndexedTree, when the indexes are known in advance.
+			//
+			//Note: The indexes start from 1.
+			template <typename Number>
+			class SparseBinaryIndexedTree final
+			{
+			public:
+
+				using Index = std::uint64_t;
+
+				static constexpr Index InitialIndex = 1;
+
+				explicit SparseBinaryIndexedTree(
+					Index maxIndex = std::numeric_limits<Index>::max());
+
+				//Return the maximum supported index.
+				inline Index max_index() const
+				{
+					return _MaxIndex;
+				}
+
+				//Return the number of the stored nodes.
+				inline size_t node_count() const
+				{
+					return _Count;
+				}
+
+				//Return the longest distance of a stored node from its home cell,
+				// for the tests and the diagnostics: the hash quality is seen here.
+				size_t max_probe() const;
+
+				//When "leftInclusive" is ether 0 or 1,
+				// the sum is taken from the beginning to the "rightInclusive".
+				//Otherwise, the returned sum is taken between indexes inclusively.
+				Number get(Index leftInclusive, Index rightInclusive) const;
+
+				//Return the sum from 1 to the "index".
+				Number get(Index index) const;
+
+				void add(Index index, const Number& increment = Number(1));
+
+			private:
+
+				//The node index 0 is never used, so that it marks an empty cell.
+				static constexpr Index EmptyIndex = 0;
+
+				Index _MaxIndex;
+
+				//The cell count is a power of 2.
+				std::vector<Index> _Indexes;
+				std::vector<Number> _Values;
+
+				size_t _Count;
+
+				//64 - log2(cell count).
+				unsigned _Shift;
+
+				void check_index(const Index index) const;
+
+				//Return the cell of the node "index", or the empty cell, where it would be.
+				size_t find(const Index index) const;
+
+				//Double the cells, and put the nodes again.
+				void grow();
+
+				//Fibonacci hashing: the top bits of the product depend on all the index bits,
+				// so the top log2(cell count) of them are taken.
+				inline size_t home(const Index index) const
+				{
+					return static_cast<size_t>((index * 0x9E3779B97F4A7C15ull) >> _Shift);
+				}
+			};
+
+			template <typename Number>
+			SparseBinaryIndexedTree<Number>::SparseBinaryIndexedTree(Index maxIndex)
+				: _MaxIndex(maxIndex),
+				_Indexes(16, EmptyIndex),
+				_Values(16),
+				_Count(0),
+				_Shift(64 - 4)
+			{
+			}
+
+			template <typename Number>
+			Number SparseBinaryIndexedTree<Number>::get(
+				Index leftInclusive, Index rightInclusive) const
+			{
+#ifdef _DEBUG
+				if (rightInclusive < leftInclusive)
+				{
+					std::ostringstream ss;
+					ss << "The rightInclusive (" << rightInclusive
+						<< ") cannot be smaller than leftInclusive (" << leftInclusive
+						<< "), size=" << _MaxIndex << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+#endif
+				const auto result = leftInclusive <= InitialIndex
+					? get(rightInclusive)
+					: static_cast<Number>(get(rightInclusive) - get(leftInclusive - InitialIndex));
+				return result;
+			}
+
+			template <typename Number>
+			Number SparseBinaryIndexedTree<Number>::get(Index index) const
+			{
+				check_index(index);
+
+				Number result{};
+				do
+				{
+					const auto cell = find(index);
+					if (EmptyIndex != _Indexes[cell])
+					{
+						result += _Values[cell];
+					}
+
+					index &= index - 1; //Remove the right-most 1-bit.
+				} while (0 != index);
+
+				return result;
+			}
+
+			template <typename Number>
+			void SparseBinaryIndexedTree<Number>::add(Index index, const Number& increment)
+			{
+				check_index(index);
+
+				for (;;)
+				{
+					auto cell = find(index);
+					if (EmptyIndex == _Indexes[cell])
+					{
+						//At most a half of the cells are used, to keep the probes short.
+						if (_Indexes.size() <= (_Count + 1) * 2)
+						{
+							grow();
+							cell = find(index);
+						}
+
+						_Indexes[cell] = index;
+						++_Count;
+					}
+
+					_Values[cell] += increment;
+
+					const auto step = index & (0 - index); //The right-most 1-bit.
+					if (_MaxIndex - index < step)
+					{
+						break;
+					}
+
+					index += step;
+				}
+			}
+
+			template <typename Number>
+			size_t SparseBinaryIndexedTree<Number>::max_probe() const
+			{
+				const auto mask = _Indexes.size() - 1;
+
+				size_t result = 0;
+				for (size_t cell = 0; cell < _Indexes.size(); ++cell)
+				{
+					if (EmptyIndex != _Indexes[cell])
+					{
+						const auto probe = (cell - home(_Indexes[cell])) & mask;
+						result = std::max(result, probe);
+					}
+				}
+
+				return result;
+			}
+
+			template <typename Number>
+			void SparseBinaryIndexedTree<Number>::check_index(const Index index) const
+			{
+				if (0 == index || _MaxIndex < index)
+				{
+					std::ostringstream ss;
+					ss << "The index (" << index
+						<< ") must be between " << InitialIndex
+						<< " and " << _MaxIndex << ".";
+					StreamUtilities::ThrowException<std::out_of_range>(ss);
+				}
+			}
+
+			template <typename Number>
+			size_t SparseBinaryIndexedTree<Number>::find(const Index index) const
+			{
+				const auto mask = _Indexes.size() - 1;
+
+				auto cell = home(index);
+				while (EmptyIndex != _Indexes[cell] && index != _Indexes[cell])
+				{
+					cell = (cell + 1) & mask;
+				}
+
+				return cell;
+			}
+
+			template <typename Number>
+			void SparseBinaryIndexedTree<Number>::grow()
+			{
+				std::vector<Index> indexes(_Indexes.size() * 2, EmptyIndex);
+				std::vector<Number> values(indexes.size());
+				indexes.swap(_Indexes);
+				values.swap(_Values);
+				--_Shift;
+
+				for (size_t cell = 0; cell < indexes.size(); ++cell)
+				{
+					if (EmptyIndex != indexes[cell])
+					{
+						const auto newCell = find(indexes[cell]);
+						_Indexes[newCell] = indexes[cell];
+						_Values[newCell] = values[cell];
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,332 @@
+#pragma once
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+#include <emmintrin.h>
+#define UTF8_UTILITIES_SSE2 1
+#endif
+
+//The table lookups of the validation need the PSHUFB.
+#if defined(UTF8_UTILITIES_SSE2) && (defined(__SSSE3__) || defined(__AVX__))
+#include <tmmintrin.h>
+#define UTF8_UTILITIES_SSSE3 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "StreamUtilities.h"
+
+namespace MyCompany
+{
+  namespace Algorithms
+  {
+    namespace Utf8Utilities
+    {
+      //Whether the "letter" is not the first byte of a codepoint.
+      inline bool IsContinuation(const char letter)
+      {
+        return 0x80 == (static_cast<unsigned char>(letter) & 0xC0);
+      }
+
+      //The number of codepoints in a valid UTF-8 "text".
+      inline size_t CodepointCount(const std::string& text)
+      {
+        size_t result = 0;
+        for (const auto& letter : text)
+        {
+          result += IsContinuation(letter) ? 0 : 1;
+        }
+
+        return result;
+      }
+
+      //Validate one codepoint at the "offset", and return its length in bytes.
+      //An overlong form, a surrogate, or a codepoint above U+10FFFF is invalid.
+      inline size_t DecodeLength(const char* data, const size_t size, const size_t offset)
+      {
+        const auto lead = static_cast<unsigned char>(data[offset]);
+
+        size_t length = 0;
+        unsigned minimum = 0;
+        unsigned codepoint = 0;
+        if (lead < 0x80)
+        {
+          return 1;
+        }
+        else if (0xC0 == (lead & 0xE0))
+        {
+          length = 2;
+          minimum = 0x80;
+          codepoint = lead & 0x1F;
+        }
+        else if (0xE0 == (lead & 0xF0))
+        {
+          length = 3;
+          minimum = 0x800;
+          codepoint = lead & 0x0F;
+        }
+        else if (0xF0 == (lead & 0xF8))
+        {
+          length = 4;
+          minimum = 0x10000;
+          codepoint = lead & 0x07;
+        }
+
+        auto isValid = 0 != length && length <= size - offset;
+        for (size_t index = 1; isValid && index < length; ++index)
+        {
+          const auto letter = data[offset + index];
+          isValid = IsContinuation(letter);
+          codepoint = (codepoint << 6) | (static_cast<unsigned char>(letter) & 0x3F);
+        }
+
+        if (!isValid
+          || codepoint < minimum || 0x10FFFF < codepoint
+          || (0xD800 <= codepoint && codepoint <= 0xDFFF))
+        {
+          std::ostringstream ss;
+          ss << "Invalid UTF-8 codepoint at the byte " << offset << ".";
+          StreamUtilities::ThrowException(ss);
+        }
+
+        return length;
+      }
+
+      //Return the index of the lowest 1-bit of a non-zero "mask".
+      inline unsigned TrailingZeroCount(const unsigned mask)
+      {
+#ifdef _MSC_VER
+        unsigned long result;
+        _BitScanForward(&result, mask);
+        return static_cast<unsigned>(result);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+      }
+
+#ifdef UTF8_UTILITIES_SSE2
+      //Store "offset + i" for each 1-bit "i" of the "mask", the lowest first,
+      // and return the end of the stored ones.
+      template <typename TSize>
+      inline TSize* StoreOffsets(unsigned mask, const size_t offset, TSize* output)
+      {
+        if (0xFFFF == mask)
+        {//A loop of the known length is vectorized.
+          for (size_t index = 0; index < 16; ++index)
+          {
+            output[index] = static_cast<TSize>(offset + index);
+          }
+
+          return output + 16;
+        }
+
+        while (0 != mask)
+        {
+          *output++ = static_cast<TSize>(offset + TrailingZeroCount(mask));
+          mask &= mask - 1;
+        }
+
+        return output;
+      }
+
+      //The bit i is set, when the byte i is not a continuation one (10xxxxxx).
+      inline unsigned LeadMask(const __m128i block)
+      {
+        //The continuation bytes are the signed [-128, -65].
+        const auto isContinuation = _mm_cmplt_epi8(block, _mm_set1_epi8(-64));
+        return ~static_cast<unsigned>(_mm_movemask_epi8(isContinuation)) & 0xFFFF;
+      }
+#endif
+
+#ifdef UTF8_UTILITIES_SSSE3
+      //The "block" bytes, preceded by the last ones of the "previous" block.
+      template <int Count>
+      inline __m128i Previous(const __m128i block, const __m128i previous)
+      {
+        return _mm_alignr_epi8(block, previous, 16 - Count);
+      }
+
+      inline __m128i HighNibbles(const __m128i block)
+      {
+        return _mm_and_si128(_mm_srli_epi16(block, 4), _mm_set1_epi8(0x0F));
+      }
+
+      //The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction
+      // Per Byte": a pair of adjacent bytes is classified by three 16-entry tables,
+      // indexed by the high and low nibbles of the first byte and the high nibble of the second.
+      //A bit is set in all three only for an invalid pair.
+      //The third and fourth bytes of a codepoint are checked by its lead byte, 2 or 3 bytes back.
+      //Return non-zero bytes, when the "block" is invalid after the "previous" one.
+      inline __m128i Utf8Errors(const __m128i block, const __m128i previous)
+      {
+        constexpr char tooShort = 1 << 0; //11______ 0_______, 11______ 11______
+        constexpr char tooLong = 1 << 1; //0_______ 10______
+        constexpr char overlong3 = 1 << 2; //11100000 100_____
+        constexpr char tooLarge = 1 << 3; //11110100 1001____, 11110100 101_____, 11110101+ 1_______
+        constexpr char surrogate = 1 << 4; //11101101 101_____
+        constexpr char overlong2 = 1 << 5; //1100000_ 10______
+        constexpr char tooLarge1000 = 1 << 6; //11110101+ 1000____
+        constexpr char overlong4 = 1 << 6; //11110000 1000____
+        constexpr char twoContinuations = static_cast<char>(1 << 7); //10______ 10______
+        constexpr char carry = tooShort | tooLong | twoContinuations;
+
+        const auto previous1 = Previous<1>(block, previous);
+
+        const auto byte1High = _mm_shuffle_epi8(_mm_setr_epi8(
+          //0_______ <ASCII>
+          tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+          //10______ <continuation>
+          twoContinuations, twoContinuations, twoContinuations, twoContinuations,
+          //1100____, 1101____ <2-byte lead>
+          tooShort | overlong2, tooShort,
+          //1110____ <3-byte lead>
+          tooShort | overlong3 | surrogate,
+          //1111____ <4-byte lead>
+          tooShort | tooLarge | tooLarge1000 | overlong4),
+          HighNibbles(previous1));
+
+        const auto byte1Low = _mm_shuffle_epi8(_mm_setr_epi8(
+          //____0000, ____0001
+          carry | overlong3 | overlong2 | overlong4, carry | overlong2,
+          //____001_
+          carry, carry,
+          //____0100
+          carry | tooLarge,
+          //____0101, ____011_
+          carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+          //____1___
+          carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+          carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+          carry | tooLarge | tooLarge1000,
+          //____1101
+          carry | tooLarge | tooLarge1000 | surrogate,
+          carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000),
+          _mm_and_si128(previous1, _mm_set1_epi8(0x0F)));
+
+        const auto byte2High = _mm_shuffle_epi8(_mm_setr_epi8(
+          //0_______ <ASCII>
+          tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+          //1000____
+          tooLong | overlong2 | twoContinuations | overlong3 | tooLarge1000 | overlong4,
+          //1001____
+          tooLong | overlong2 | twoContinuations | overlong3 | tooLarge,
+          //101_____
+          tooLong | overlong2 | twoContinuations | surrogate | tooLarge,
+          tooLong | overlong2 | twoContinuations | surrogate | tooLarge,
+          //11______
+          tooShort, tooShort, tooShort, tooShort),
+          HighNibbles(block));
+
+        const auto pairErrors = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+        //The third byte after 111_____ and the fourth after 1111____ must be continuations:
+        // they have the "twoContinuations" bit, and it is flipped back.
+        const auto isThird = _mm_subs_epu8(Previous<2>(block, previous), _mm_set1_epi8(0xE0 - 0x80));
+        const auto isFourth = _mm_subs_epu8(Previous<3>(block, previous), _mm_set1_epi8(0xF0 - 0x80));
+        const auto mustBeContinuation = _mm_and_si128(_mm_or_si128(isThird, isFourth),
+          _mm_set1_epi8(twoContinuations));
+
+        return _mm_xor_si128(mustBeContinuation, pairErrors);
+      }
+#endif
+
+      //Validate the UTF-8 text, and store the byte offsets
+      // of all its codepoints, followed by the "size".
+      //
+      //With SSE2, a block of 16 bytes is classified by one compare:
+      // the movemask of its non-continuation bytes is the bitmap of the boundaries,
+      // which are stored by counting the trailing zeros, without decoding.
+      //With SSSE3 (or AVX), the block is also validated by the table lookups;
+      // only SSE2 leaves the validation of a non-ASCII block to the scalar decoder,
+      // which is called at the boundaries of the movemask only.
+      //The invalid text is decoded again by the scalar decoder to report the exact byte.
+      template <typename TSize>
+      void IndexBoundaries(const char* data, const size_t size,
+        std::vector<TSize>& boundaries)
+      {
+        //There are at most "size" codepoints; the boundaries are stored by a pointer.
+        boundaries.resize(size + 1);
+        const auto first = boundaries.data();
+        auto output = first;
+
+        size_t offset = 0;
+#ifdef UTF8_UTILITIES_SSE2
+        constexpr size_t blockSize = sizeof(__m128i);
+#ifdef UTF8_UTILITIES_SSSE3
+        auto previous = _mm_setzero_si128();
+
+        //The last 3 bytes of a block are above these, when a codepoint starts there, and needs more bytes.
+        const auto incompleteTail = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+          -1, -1, -1, -1, -1, static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+        for (; blockSize <= size - offset; offset += blockSize)
+        {
+          const auto block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(data + offset));
+
+          //An ASCII block is valid, unless a codepoint of the previous one is not complete.
+          const auto errors = 0 == _mm_movemask_epi8(block)
+            ? _mm_subs_epu8(previous, incompleteTail)
+            : Utf8Errors(block, previous);
+          if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())))
+          {
+            break;
+          }
+
+          output = StoreOffsets(LeadMask(block), offset, output);
+          previous = block;
+        }
+
+        //The last codepoint may continue after the valid blocks, or be invalid,
+        // the codepoints before it being valid: it is decoded again.
+        if (first != output)
+        {
+          offset = *--output;
+        }
+#else
+        while (blockSize <= size - offset)
+        {
+          const auto block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(data + offset));
+
+          const auto blockEnd = offset + blockSize;
+          if (0 == _mm_movemask_epi8(block))
+          {
+            output = StoreOffsets(0xFFFF, offset, output);
+            offset = blockEnd;
+            continue;
+          }
+
+          //The boundaries are the lead bytes of the movemask; each codepoint is validated
+          // by the scalar decoder, and must end at the next lead byte, or past the block.
+          const auto blockBegin = offset;
+          for (auto mask = LeadMask(block);
+            0 != mask && blockBegin + TrailingZeroCount(mask) == offset;
+            mask &= mask - 1)
+          {//The decoder has checked the continuation bytes, which are not in the mask.
+            *output++ = static_cast<TSize>(offset);
+            offset += DecodeLength(data, size, offset);
+          }
+
+          if (offset < blockEnd)
+          {//A continuation byte without a lead one is reported below.
+            break;
+          }
+        }
+#endif
+#endif
+        while (offset < size)
+        {
+          *output++ = static_cast<TSize>(offset);
+          offset += DecodeLength(data, size, offset);
+        }
+
+        *output++ = static_cast<TSize>(size);
+        boundaries.resize(static_cast<size_t>(output - first));
+      }
+    }
+  }
+}
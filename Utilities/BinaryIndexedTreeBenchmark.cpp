@@ -0,0 +1,466 @@
+//Measures the BinaryIndexedTree variants,
+// and writes one CSV row per measurement to the stdout.
+//
+//Usage: BinaryIndexedTreeBenchmark.exe [--slots N] [--operations N] [--max-threads N]
+//  [--read-percent P] [--layout-max-slots N]
+//
+//Concurrent: from 1 to "max-threads" threads, each doing the "operations",
+// a "read-percent" of them are prefix sums, the rest are adds at random indexes.
+//
+//Layout: the plain, blocked and leaf scan trees of 10^6, 10^8, 10^9 slots, up to "layout-max-slots",
+// are built, then do the "operations" prefix sums, then as many adds, in one thread.
+//Only 10^6 by default: a tree of 10^8 slots takes 800 MB, of 10^9 - 8 GB,
+// so use "--layout-max-slots 1000000000" to measure them; "0" skips the layout.
+//Compare the trees at the target size: the blocked adds, faster at 10^6, are slower at 10^8.
+//
+//Columns: benchmark, tree, threads, slots, operations, seconds, mops_per_second,
+// where the operations are the total of all the threads.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Algorithms/Trees/BinaryIndexedTree.h"
+#include "../Algorithms/Trees/BlockedBinaryIndexedTree.h"
+#include "../Algorithms/Trees/ConcurrentBinaryIndexedTree.h"
+#include "../Algorithms/Trees/ShardedBinaryIndexedTree.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Trees;
+
+namespace
+{
+  using Number = long long;
+
+  struct options final
+  {
+    size_t slots = 1 << 20;
+    size_t operations = 1000 * 1000;
+    size_t max_threads = 64;
+    size_t read_percent = 5;
+    size_t layout_max_slots = 1000 * 1000;
+  };
+
+  bool parse_options(const int argc, char** argv, options& result)
+  {
+    for (int index = 1; index + 1 < argc; index += 2)
+    {
+      const string argument = argv[index];
+      const auto value = static_cast<size_t>(stoull(argv[index + 1]));
+      if ("--slots" == argument)
+      {
+        result.slots = value;
+      }
+      else if ("--operations" == argument)
+      {
+        result.operations = value;
+      }
+      else if ("--max-threads" == argument)
+      {
+        result.max_threads = value;
+      }
+      else if ("--read-percent" == argument)
+      {
+        result.read_percent = value;
+      }
+      else if ("--layout-max-slots" == argument)
+      {
+        result.layout_max_slots = value;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    return 1 == argc % 2 && 1 < result.slots && 0 < result.max_threads && result.read_percent <= 100;
+  }
+
+  //xorshift64*: cheap enough not to hide the tree cost.
+  class random_numbers final
+  {
+    uint64_t _state;
+
+  public:
+
+    explicit random_numbers(const uint64_t seed)
+      : _state(seed * 0x9E3779B97F4A7C15ull + 1)
+    {
+    }
+
+    uint64_t next()
+    {
+      _state ^= _state >> 12;
+      _state ^= _state << 25;
+      _state ^= _state >> 27;
+      return _state * 0x2545F4914F6CDD1Dull;
+    }
+  };
+
+  //The plain tree, guarded by a mutex: the baseline.
+  class locked_tree final
+  {
+    BinaryIndexedTree<Number> _tree;
+    mutable mutex _mutex;
+
+  public:
+
+    explicit locked_tree(const size_t size)
+      : _tree(size)
+    {
+    }
+
+    Number get(const size_t index) const
+    {
+      lock_guard<mutex> lock(_mutex);
+      return _tree.get(index);
+    }
+
+    void add(const size_t index, const Number& increment)
+    {
+      lock_guard<mutex> lock(_mutex);
+      _tree.add(index, increment);
+    }
+  };
+
+  void print_row(const char* benchmark, const char* tree, const size_t threads,
+    const size_t slots, const size_t operations, const double seconds)
+  {
+    cout << benchmark << ',' << tree << ',' << threads << ',' << slots << ','
+      << operations << ',' << seconds << ',' << (operations / seconds / 1e6) << endl;
+  }
+
+  template <typename Tree>
+  void run_concurrent(const options& settings, const char* name, const size_t thread_count)
+  {
+    Tree tree(settings.slots);
+
+    //A slot per thread, so that the sums are kept without a data race.
+    vector<Number> sums(thread_count);
+
+    //The threads start together, as soon as all of them have been created.
+    atomic<size_t> waiting(thread_count);
+    chrono::steady_clock::time_point started;
+
+    const auto run = [&](const size_t thread_index)
+    {
+      --waiting;
+      while (0 != waiting.load())
+      {
+        this_thread::yield();
+      }
+
+      if (0 == thread_index)
+      {
+        started = chrono::steady_clock::now();
+      }
+
+      random_numbers random(thread_index);
+      Number sum = 0;
+      for (size_t operation = 0; operation < settings.operations; ++operation)
+      {
+        const auto value = random.next();
+        const auto index = static_cast<size_t>(value % settings.slots) + 1;
+        if ((value >> 32) % 100 < settings.read_percent)
+        {
+          sum += tree.get(index);
+        }
+        else
+        {
+          tree.add(index, 1);
+        }
+      }
+
+      sums[thread_index] = sum;
+    };
+
+    vector<thread> threads;
+    for (size_t thread_index = 1; thread_index < thread_count; ++thread_index)
+    {
+      threads.emplace_back(run, thread_index);
+    }
+
+    run(0);
+    for (auto& worker : threads)
+    {
+      worker.join();
+    }
+
+    const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    print_row("concurrent", name, thread_count, settings.slots,
+      settings.operations * thread_count, seconds);
+
+    for (const auto& sum : sums)
+    {
+      if (sum < 0)
+      {
+        throw runtime_error("The prefix sums of ones cannot be negative.");
+      }
+    }
+  }
+
+  void run_concurrent(const options& settings)
+  {
+    for (size_t thread_count = 1; thread_count <= settings.max_threads; thread_count *= 2)
+    {
+      run_concurrent<locked_tree>(settings, "Mutex", thread_count);
+      run_concurrent<ConcurrentBinaryIndexedTree<Number>>(settings, "Concurrent", thread_count);
+      run_concurrent<ShardedBinaryIndexedTree<Number>>(settings, "Sharded", thread_count);
+    }
+  }
+
+  //Yields 1 at every position, so that a tree is built without a copy of the values.
+  //It is random access, so that the trees take the distance in O(1)
+  // rather than by a walk over 10^9 positions.
+  class ones_iterator final
+  {
+    size_t _position;
+
+  public:
+
+    using iterator_category = random_access_iterator_tag;
+    using value_type = Number;
+    using difference_type = ptrdiff_t;
+    using pointer = const Number*;
+    using reference = Number;
+
+    ones_iterator()
+      : _position(0)
+    {
+    }
+
+    explicit ones_iterator(const size_t position)
+      : _position(position)
+    {
+    }
+
+    Number operator*() const
+    {
+      return 1;
+    }
+
+    Number operator[](const difference_type) const
+    {
+      return 1;
+    }
+
+    ones_iterator& operator++()
+    {
+      ++_position;
+      return *this;
+    }
+
+    ones_iterator operator++(int)
+    {
+      const auto result = *this;
+      ++_position;
+      return result;
+    }
+
+    ones_iterator& operator--()
+    {
+      --_position;
+      return *this;
+    }
+
+    ones_iterator operator--(int)
+    {
+      const auto result = *this;
+      --_position;
+      return result;
+    }
+
+    ones_iterator& operator+=(const difference_type offset)
+    {
+      _position += offset;
+      return *this;
+    }
+
+    ones_iterator& operator-=(const difference_type offset)
+    {
+      _position -= offset;
+      return *this;
+    }
+
+    ones_iterator operator+(const difference_type offset) const
+    {
+      return ones_iterator(_position + offset);
+    }
+
+    ones_iterator operator-(const difference_type offset) const
+    {
+      return ones_iterator(_position - offset);
+    }
+
+    difference_type operator-(const ones_iterator& other) const
+    {
+      return static_cast<difference_type>(_position - other._position);
+    }
+
+    bool operator==(const ones_iterator& other) const
+    {
+      return _position == other._position;
+    }
+
+    bool operator!=(const ones_iterator& other) const
+    {
+      return _position != other._position;
+    }
+
+    bool operator<(const ones_iterator& other) const
+    {
+      return _position < other._position;
+    }
+
+    bool operator>(const ones_iterator& other) const
+    {
+      return other._position < _position;
+    }
+
+    bool operator<=(const ones_iterator& other) const
+    {
+      return _position <= other._position;
+    }
+
+    bool operator>=(const ones_iterator& other) const
+    {
+      return other._position <= _position;
+    }
+  };
+
+  //The blocked layout, but a block has the raw values rather than the running sums:
+  // a prefix sum adds the block values up to the index by a loop the compiler vectorizes,
+  // and an add writes one value. It is here to be compared with the BlockedBinaryIndexedTree.
+  template <size_t BlockSize>
+  class leaf_scan_tree final
+  {
+    //The [0] is unused.
+    vector<Number> _values;
+
+    //The block "b" (from 0) is at the index b + 1.
+    BinaryIndexedTree<Number> _blocks;
+
+  public:
+
+    template <typename TIterator>
+    leaf_scan_tree(TIterator begin, TIterator end)
+      : _values(static_cast<size_t>(distance(begin, end)) + 1),
+      _blocks(1)
+    {
+      vector<Number> totals((_values.size() - 1 + BlockSize - 1) / BlockSize);
+      for (size_t index = 1; begin != end; ++begin, ++index)
+      {
+        _values[index] = *begin;
+        totals[(index - 1) / BlockSize] += *begin;
+      }
+
+      _blocks = BinaryIndexedTree<Number>(totals.begin(), totals.end());
+    }
+
+    Number get(const size_t index) const
+    {
+      const auto block = (index - 1) / BlockSize;
+      const auto values = _values.data();
+
+      Number result = 0;
+      for (auto slot = block * BlockSize + 1; slot <= index; ++slot)
+      {
+        result += values[slot];
+      }
+
+      if (0 < block)
+      {
+        result += _blocks.get(block);
+      }
+
+      return result;
+    }
+
+    void add(const size_t index, const Number& increment)
+    {
+      _values[index] += increment;
+      _blocks.add((index - 1) / BlockSize + 1, increment);
+    }
+  };
+
+  //Every page is written by the build, so that the sums do not read the shared zero pages.
+  template <typename Tree>
+  void run_layout(const options& settings, const char* name, const size_t slots)
+  {
+    auto started = chrono::steady_clock::now();
+    Tree tree(ones_iterator(0), ones_iterator(slots));
+    auto seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    print_row("layout_build", name, 1, slots, slots, seconds);
+
+    random_numbers random(slots);
+    Number sum = 0;
+
+    started = chrono::steady_clock::now();
+    for (size_t operation = 0; operation < settings.operations; ++operation)
+    {
+      sum += tree.get(static_cast<size_t>(random.next() % slots) + 1);
+    }
+
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    print_row("layout_get", name, 1, slots, settings.operations, seconds);
+    if (sum < 0)
+    {
+      throw runtime_error("The prefix sums of ones cannot be negative.");
+    }
+
+    started = chrono::steady_clock::now();
+    for (size_t operation = 0; operation < settings.operations; ++operation)
+    {
+      tree.add(static_cast<size_t>(random.next() % slots) + 1, 1);
+    }
+
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    print_row("layout_add", name, 1, slots, settings.operations, seconds);
+  }
+
+  void run_layout(const options& settings)
+  {
+    for (size_t slots = 1000 * 1000; slots <= settings.layout_max_slots;
+      slots *= slots < 100 * 1000 * 1000 ? 100 : 10)
+    {
+      run_layout<BinaryIndexedTree<Number>>(settings, "Plain", slots);
+      run_layout<BlockedBinaryIndexedTree<Number, 16>>(settings, "Blocked16", slots);
+      run_layout<BlockedBinaryIndexedTree<Number, 64>>(settings, "Blocked64", slots);
+      run_layout<leaf_scan_tree<16>>(settings, "LeafScan16", slots);
+      run_layout<leaf_scan_tree<64>>(settings, "LeafScan64", slots);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  options settings;
+  if (!parse_options(argc, argv, settings))
+  {
+    cerr << "Usage: BinaryIndexedTreeBenchmark.exe [--slots N] [--operations N] [--max-threads N]"
+      << " [--read-percent P] [--layout-max-slots N]\n";
+    return 1;
+  }
+
+  try
+  {
+    cout << "benchmark,tree,threads,slots,operations,seconds,mops_per_second\n";
+    run_concurrent(settings);
+    run_layout(settings);
+  }
+  catch (const exception& e)
+  {
+    cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,674 @@
+//Measures the WordRecognizer on synthetic dictionaries and texts,
+// and writes one CSV row per measurement to the stdout.
+//
+//Usage: WordRecognizerBenchmark.exe [--quick] [--max-words N] [--max-text-bytes N]
+//  [--hit-ratio R] [--min-seconds S] [--seed N] [--bigram-words N] [--bigram-text-bytes N]
+//
+//The dictionaries have from 1K to 1M words, the texts from 1 KB to 100 MB;
+// the "--quick" stops at 10K words and 100 KB.
+//The word lengths and letters follow the English frequencies.
+//A text is made of the dictionary words, and of random letters between them,
+// so that the "hit ratio" of its bytes belong to the words.
+//The generator has its own random numbers, so that the data are the same on any platform.
+//
+//The BigramRecognizer is compared with the DoubleArrayTrie unigram engine
+// on 20K words, 10 bigrams per word on average, and a 2 MB text;
+// the "--quick" uses 2K words and 100 KB.
+//The RecognizeApproximate, within 0 to 2 edits, with and without the "isNearUnknownOnly",
+// is given the same words, and a text of 1/256 of that size,
+// a letter in 32 being replaced by a random one.
+//The UTF-8 mode is measured on the same sizes, the letters being also mapped
+// to the CJK ideographs of 3 bytes: the boundaries of the ASCII and of the CJK text,
+// and the RecognizeUtf8 of the CJK text.
+//
+//Columns:
+// - dictionary, method: which Recognize overload is called.
+// - size_type, weight_type: the TSize and TWeight.
+// - words, text_bytes, hit_ratio: the data.
+// - calls, seconds_per_call, mb_per_second: the average over the calls.
+// - allocations_per_call, allocated_bytes_per_call: the heap allocations inside the calls.
+// - peak_bytes: the most heap bytes, allocated by a call, on top of the memory before it.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "../Algorithms/Regression/BigramRecognizer.h"
+#include "../Algorithms/Regression/DoubleArrayTrie.h"
+#include "../Algorithms/Regression/MappedDictionary.h"
+#include "../Algorithms/Regression/WordPrefilter.h"
+#include "../Algorithms/Regression/WordRecognizer.h"
+#include "../Algorithms/Utf8Utilities.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms::Regression;
+
+namespace
+{
+  //The heap usage of the whole process.
+  atomic<size_t> allocation_count(0);
+  atomic<size_t> allocated_bytes(0);
+  atomic<size_t> live_bytes(0);
+  atomic<size_t> peak_live_bytes(0);
+
+  //Each block starts with its size, padded to keep the alignment.
+  constexpr size_t header_size = alignof(max_align_t) < sizeof(size_t)
+    ? sizeof(size_t) : alignof(max_align_t);
+
+  void* allocate(const size_t size)
+  {
+    auto block = static_cast<char*>(malloc(header_size + size));
+    if (nullptr == block)
+    {
+      throw bad_alloc();
+    }
+
+    *reinterpret_cast<size_t*>(block) = size;
+
+    ++allocation_count;
+    allocated_bytes += size;
+    const auto live = live_bytes += size;
+
+    auto peak = peak_live_bytes.load();
+    while (peak < live && !peak_live_bytes.compare_exchange_weak(peak, live))
+    {
+    }
+
+    return block + header_size;
+  }
+
+  void deallocate(void* pointer)
+  {
+    if (nullptr == pointer)
+    {
+      return;
+    }
+
+    auto block = static_cast<char*>(pointer) - header_size;
+    live_bytes -= *reinterpret_cast<size_t*>(block);
+    free(block);
+  }
+}
+
+void* operator new(size_t size)
+{
+  return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+  return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+  deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+  deallocate(pointer);
+}
+
+namespace
+{
+  struct options final
+  {
+    size_t max_words = 1000 * 1000;
+    size_t max_text_bytes = 100 << 20;
+    double hit_ratio = 0.9;
+    double min_seconds = 0.5;
+    uint64_t seed = 1;
+    size_t bigram_words = 20 * 1000;
+    size_t bigram_text_bytes = 2 << 20;
+  };
+
+  bool parse_options(const int argc, char** argv, options& result)
+  {
+    for (int index = 1; index < argc; ++index)
+    {
+      const string argument = argv[index];
+      const auto has_value = index + 1 < argc;
+      if ("--quick" == argument)
+      {
+        result.max_words = 10 * 1000;
+        result.max_text_bytes = 100 << 10;
+        result.min_seconds = 0.1;
+        result.bigram_words = 2 * 1000;
+        result.bigram_text_bytes = 100 << 10;
+      }
+      else if ("--max-words" == argument && has_value)
+      {
+        result.max_words = stoull(argv[++index]);
+      }
+      else if ("--max-text-bytes" == argument && has_value)
+      {
+        result.max_text_bytes = stoull(argv[++index]);
+      }
+      else if ("--hit-ratio" == argument && has_value)
+      {
+        result.hit_ratio = stod(argv[++index]);
+      }
+      else if ("--min-seconds" == argument && has_value)
+      {
+        result.min_seconds = stod(argv[++index]);
+      }
+      else if ("--seed" == argument && has_value)
+      {
+        result.seed = stoull(argv[++index]);
+      }
+      else if ("--bigram-words" == argument && has_value)
+      {
+        result.bigram_words = stoull(argv[++index]);
+      }
+      else if ("--bigram-text-bytes" == argument && has_value)
+      {
+        result.bigram_text_bytes = stoull(argv[++index]);
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    return 0 <= result.hit_ratio && result.hit_ratio <= 1 && 0 < result.bigram_words;
+  }
+
+  //SplitMix64: unlike the std distributions, it gives the same numbers everywhere.
+  class random_numbers final
+  {
+    uint64_t _state;
+
+  public:
+
+    explicit random_numbers(const uint64_t seed)
+      : _state(seed)
+    {
+    }
+
+    uint64_t next()
+    {
+      auto result = (_state += 0x9E3779B97F4A7C15ull);
+      result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ull;
+      result = (result ^ (result >> 27)) * 0x94D049BB133111EBull;
+      return result ^ (result >> 31);
+    }
+
+    //In [0, 1).
+    double unit()
+    {
+      return static_cast<double>(next() >> 11) / static_cast<double>(uint64_t(1) << 53);
+    }
+
+    //Pick an index by the "weights".
+    size_t pick(const vector<double>& weights, const double total)
+    {
+      auto value = unit() * total;
+      for (size_t index = 0; index + 1 < weights.size(); ++index)
+      {
+        if (value < weights[index])
+        {
+          return index;
+        }
+
+        value -= weights[index];
+      }
+
+      return weights.size() - 1;
+    }
+  };
+
+  //The percentage of the English words of the length "index + 1".
+  const vector<double> length_weights{
+    0.5, 3, 8, 12, 13, 13, 12, 10, 8, 6,
+    4, 3, 2, 1.5, 1, 0.7, 0.5, 0.3, 0.2, 0.1 };
+
+  //The letter frequencies in the English text, 'a' to 'z'.
+  const vector<double> letter_weights{
+    8.2, 1.5, 2.8, 4.3, 12.7, 2.2, 2.0, 6.1, 7.0, 0.15, 0.77, 4.0, 2.4,
+    6.7, 7.5, 1.9, 0.095, 6.0, 6.3, 9.1, 2.8, 0.98, 2.4, 0.15, 2.0, 0.074 };
+
+  double sum(const vector<double>& weights)
+  {
+    double result = 0;
+    for (const auto& weight : weights)
+    {
+      result += weight;
+    }
+
+    return result;
+  }
+
+  void append_letters(random_numbers& random, string& text)
+  {
+    static const auto length_total = sum(length_weights);
+    static const auto letter_total = sum(letter_weights);
+
+    const auto length = random.pick(length_weights, length_total) + 1;
+    for (size_t index = 0; index < length; ++index)
+    {
+      text += static_cast<char>('a' + random.pick(letter_weights, letter_total));
+    }
+  }
+
+  vector<string> generate_words(random_numbers& random, const size_t count)
+  {
+    unordered_set<string> unique;
+    vector<string> result;
+    result.reserve(count);
+
+    string word;
+    while (result.size() < count)
+    {
+      word.clear();
+      append_letters(random, word);
+      if (unique.insert(word).second)
+      {
+        result.push_back(word);
+      }
+    }
+
+    return result;
+  }
+
+  //Append the words or the random letters, whichever is behind the "hit_ratio".
+  string generate_text(random_numbers& random,
+    const vector<string>& words,
+    const size_t size,
+    const double hit_ratio)
+  {
+    string result;
+    result.reserve(size + length_weights.size());
+
+    size_t word_bytes = 0;
+    while (result.size() < size)
+    {
+      if (static_cast<double>(word_bytes) < hit_ratio * static_cast<double>(result.size() + 1))
+      {
+        const auto& word = words[random.next() % words.size()];
+        result += word;
+        word_bytes += word.size();
+      }
+      else
+      {
+        append_letters(random, result);
+      }
+    }
+
+    result.resize(size);
+    return result;
+  }
+
+  //E.g. "uint32", "int64" or "float64".
+  template <typename T>
+  string type_name()
+  {
+    const auto result = string(is_floating_point<T>::value ? "float"
+      : is_signed<T>::value ? "int" : "uint")
+      + to_string(8 * sizeof(T));
+    return result;
+  }
+
+  struct data_set final
+  {
+    const options* settings;
+    size_t word_count;
+    const vector<string>* words;
+    const string* text;
+  };
+
+  void print_header()
+  {
+    cout << "dictionary,method,size_type,weight_type,words,text_bytes,hit_ratio,"
+      << "calls,seconds_per_call,mb_per_second,"
+      << "allocations_per_call,allocated_bytes_per_call,peak_bytes\n";
+  }
+
+  //Call the "action" until the "min_seconds" have passed, and print a row.
+  template <typename TSize, typename TWeight, typename TAction>
+  void measure(const data_set& data,
+    const char* dictionary,
+    const char* method,
+    TAction action)
+  {
+    const auto start_count = allocation_count.load();
+    const auto start_bytes = allocated_bytes.load();
+    const auto start_live = live_bytes.load();
+    peak_live_bytes.store(start_live);
+
+    size_t calls = 0;
+    double seconds = 0;
+
+    const auto started = chrono::steady_clock::now();
+    do
+    {
+      action();
+      ++calls;
+      seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    } while (seconds < data.settings->min_seconds);
+
+    const auto allocations = allocation_count.load() - start_count;
+    const auto bytes = allocated_bytes.load() - start_bytes;
+    const auto peak = peak_live_bytes.load() - start_live;
+
+    const auto seconds_per_call = seconds / calls;
+    const auto text_bytes = data.text->size();
+
+    cout << dictionary << ',' << method << ','
+      << type_name<TSize>() << ',' << type_name<TWeight>() << ','
+      << data.word_count << ',' << text_bytes << ',' << data.settings->hit_ratio << ','
+      << calls << ',' << seconds_per_call << ','
+      << (text_bytes / seconds_per_call / (1 << 20)) << ','
+      << (static_cast<double>(allocations) / calls) << ','
+      << (static_cast<double>(bytes) / calls) << ','
+      << peak << endl;
+  }
+
+  template <typename TSize, typename TWeight>
+  void run_types(const data_set& data)
+  {
+    using TDictionary = unordered_set<string>;
+    using TRecognizer = WordRecognizer<TSize, TWeight, TDictionary>;
+
+    const auto& text = *data.text;
+    volatile TWeight sink = {};
+
+    {
+      const TDictionary words(data.words->begin(), data.words->end());
+      const auto maxLength = TRecognizer::WordMaxLength(words);
+
+      measure<TSize, TWeight>(data, "unordered_set", "Recognize", [&]()
+      {
+        sink = TRecognizer::Recognize(text, words, maxLength).first;
+      });
+
+      typename TRecognizer::Workspace workspace;
+      vector<typename TRecognizer::WordPosition> positions;
+      TRecognizer::Recognize(text, words, maxLength, workspace, positions);
+
+      measure<TSize, TWeight>(data, "unordered_set", "Workspace", [&]()
+      {
+        sink = TRecognizer::Recognize(text, words, maxLength, workspace, positions);
+      });
+
+      const WordPrefilter<TSize> prefilter(words);
+      measure<TSize, TWeight>(data, "unordered_set", "Prefilter", [&]()
+      {
+        sink = TRecognizer::Recognize(text, words, prefilter).first;
+      });
+    }
+    {
+      const DoubleArrayTrie<TSize> trie(*data.words);
+      measure<TSize, TWeight>(data, "DoubleArrayTrie", "Recognize", [&]()
+      {
+        sink = TRecognizer::Recognize(text, trie).first;
+      });
+
+      typename TRecognizer::Workspace workspace;
+      vector<typename TRecognizer::WordPosition> positions;
+      TRecognizer::Recognize(text, trie, workspace, positions);
+
+      measure<TSize, TWeight>(data, "DoubleArrayTrie", "Workspace", [&]()
+      {
+        sink = TRecognizer::Recognize(text, trie, workspace, positions);
+      });
+    }
+    {
+      using TMappedRecognizer = WordRecognizer<TSize, TWeight, MappedDictionary>;
+
+      const string file_name = "WordRecognizerBenchmark.dictionary";
+      MappedDictionary::Write(file_name, *data.words);
+      {
+        const MappedDictionary words(file_name);
+        const auto maxLength = static_cast<TSize>(words.get_MaxLength());
+
+        measure<TSize, TWeight>(data, "MappedDictionary", "Recognize", [&]()
+        {
+          sink = TMappedRecognizer::Recognize(text, words, maxLength).first;
+        });
+      }
+      remove(file_name.c_str());
+    }
+  }
+
+  //The unigram weights fall with the word rank, as in a Zipf law,
+  // and there are 10 bigrams per word.
+  //The first word of a bigram is also picked by the Zipf law,
+  // so that the frequent words are followed by thousands of words.
+  BigramModel<unsigned int, double> generate_model(random_numbers& random,
+    const vector<string>& words)
+  {
+    using TModel = BigramModel<unsigned int, double>;
+
+    vector<TModel::Unigram> unigrams;
+    unigrams.reserve(words.size());
+    for (size_t rank = 0; rank < words.size(); ++rank)
+    {
+      unigrams.push_back({ words[rank], -log(static_cast<double>(rank + 2)), -1 });
+    }
+
+    constexpr size_t bigrams_per_word = 10;
+    unordered_set<uint64_t> pairs;
+    vector<TModel::Bigram> bigrams;
+    bigrams.reserve(words.size() * bigrams_per_word);
+
+    //The rank is exp(unit * log(size + 1)) - 1, which has the density 1 / (rank + 1).
+    const auto log_size = log(static_cast<double>(words.size() + 1));
+
+    while (bigrams.size() < words.size() * bigrams_per_word)
+    {
+      const auto first = min(static_cast<size_t>(exp(random.unit() * log_size)) - 1,
+        words.size() - 1);
+      const auto second = random.next() % words.size();
+      if (pairs.insert(first * words.size() + second).second)
+      {
+        bigrams.push_back({ words[first], words[second], -1 - random.unit() });
+      }
+    }
+
+    return TModel(unigrams, bigrams, -log(static_cast<double>(words.size() + 2)) - 5);
+  }
+
+  void run_bigram(const options& settings)
+  {
+    using TRecognizer = WordRecognizer<unsigned int, long long>;
+    using TBigramRecognizer = BigramRecognizer<unsigned int, double>;
+
+    random_numbers random(settings.seed + settings.bigram_words);
+    const auto words = generate_words(random, settings.bigram_words);
+    const auto text = generate_text(random, words, settings.bigram_text_bytes, settings.hit_ratio);
+    const data_set data{ &settings, settings.bigram_words, &words, &text };
+
+    {
+      const DoubleArrayTrie<unsigned int> trie(words);
+      volatile long long sink = 0;
+      measure<unsigned int, long long>(data, "DoubleArrayTrie", "Recognize", [&]()
+      {
+        sink = TRecognizer::Recognize(text, trie).first;
+      });
+    }
+
+    const auto model = generate_model(random, words);
+    volatile double sink = 0;
+    for (const size_t beam_width : { size_t(1), TBigramRecognizer::DefaultBeamWidth })
+    {
+      const auto method = "Bigram_beam" + to_string(beam_width);
+      measure<unsigned int, double>(data, "BigramModel", method.c_str(), [&]()
+      {
+        sink = TBigramRecognizer::Recognize(text, model, beam_width).first;
+      });
+    }
+  }
+
+  //A typo in every few words, so that the approximate walk has work to do.
+  void run_approximate(const options& settings)
+  {
+    using TRecognizer = WordRecognizer<unsigned int, long long>;
+
+    random_numbers random(settings.seed + settings.bigram_words + 2);
+    const auto words = generate_words(random, settings.bigram_words);
+
+    //The walk is much slower than the exact search, so that the text is shorter.
+    auto text = generate_text(random, words, settings.bigram_text_bytes / 256, settings.hit_ratio);
+    for (size_t index = random.next() % 32; index < text.size(); index += 32)
+    {
+      text[index] = static_cast<char>('a' + random.next() % 26);
+    }
+
+    const data_set data{ &settings, words.size(), &words, &text };
+    const DoubleArrayTrie<unsigned int> trie(words);
+
+    volatile long long sink = 0;
+    for (const size_t max_distance : { 0, 1, 2 })
+    {
+      for (const auto is_near_unknown_only : { false, true })
+      {
+        if (0 == max_distance && is_near_unknown_only)
+        {
+          continue;
+        }
+
+        const auto method = string(is_near_unknown_only
+          ? "RecognizeApproximateNearUnknown_k" : "RecognizeApproximate_k")
+          + to_string(max_distance);
+
+        measure<unsigned int, long long>(data, "DoubleArrayTrie", method.c_str(), [&]()
+        {
+          sink = TRecognizer::RecognizeApproximate(text, trie, max_distance, is_near_unknown_only).first;
+        });
+      }
+    }
+  }
+
+  //The letters 'a' to 'z' become U+4E00 to U+4E19, of 3 bytes each.
+  string to_cjk(const string& text)
+  {
+    string result;
+    result.reserve(text.size() * 3);
+    for (const auto& letter : text)
+    {
+      const auto codepoint = 0x4E00u + static_cast<unsigned>(letter - 'a');
+      result += static_cast<char>(0xE0 | (codepoint >> 12));
+      result += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+      result += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+
+    return result;
+  }
+
+  void run_utf8(const options& settings)
+  {
+    using TRecognizer = WordRecognizer<unsigned int, long long>;
+
+    random_numbers random(settings.seed + settings.bigram_words + 1);
+    const auto words = generate_words(random, settings.bigram_words);
+    const auto text = generate_text(random, words, settings.bigram_text_bytes, settings.hit_ratio);
+
+    vector<string> cjk_words;
+    cjk_words.reserve(words.size());
+    for (const auto& word : words)
+    {
+      cjk_words.push_back(to_cjk(word));
+    }
+
+    const auto cjk_text = to_cjk(text);
+
+    vector<unsigned int> boundaries;
+    volatile size_t boundaries_sink = 0;
+
+    const data_set ascii_data{ &settings, words.size(), &words, &text };
+    measure<unsigned int, long long>(ascii_data, "Utf8Utilities", "IndexBoundaries_ascii", [&]()
+    {
+      MyCompany::Algorithms::Utf8Utilities::IndexBoundaries(text.data(), text.size(), boundaries);
+      boundaries_sink = boundaries.size();
+    });
+
+    const data_set cjk_data{ &settings, cjk_words.size(), &cjk_words, &cjk_text };
+    measure<unsigned int, long long>(cjk_data, "Utf8Utilities", "IndexBoundaries_cjk", [&]()
+    {
+      MyCompany::Algorithms::Utf8Utilities::IndexBoundaries(cjk_text.data(), cjk_text.size(), boundaries);
+      boundaries_sink = boundaries.size();
+    });
+
+    const unordered_set<string> dictionary(cjk_words.begin(), cjk_words.end());
+    volatile long long sink = 0;
+    measure<unsigned int, long long>(cjk_data, "unordered_set", "RecognizeUtf8_cjk", [&]()
+    {
+      sink = TRecognizer::RecognizeUtf8(cjk_text, dictionary).first;
+    });
+  }
+
+  void run(const options& settings)
+  {
+    print_header();
+
+    for (size_t word_count = 1000; word_count <= settings.max_words; word_count *= 10)
+    {
+      random_numbers random(settings.seed + word_count);
+      const auto words = generate_words(random, word_count);
+
+      for (size_t text_bytes = 1 << 10; text_bytes <= settings.max_text_bytes; text_bytes *= 10)
+      {
+        const auto text = generate_text(random, words, text_bytes, settings.hit_ratio);
+        const data_set data{ &settings, word_count, &words, &text };
+
+        run_types<unsigned int, long long>(data);
+        run_types<size_t, long long>(data);
+
+        //The total weight of a longer text might overflow the int.
+        if (text_bytes <= (1 << 20))
+        {
+          run_types<unsigned int, int>(data);
+        }
+      }
+    }
+
+    run_bigram(settings);
+    run_approximate(settings);
+    run_utf8(settings);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  options settings;
+  if (!parse_options(argc, argv, settings))
+  {
+    cerr << "Usage: WordRecognizerBenchmark.exe [--quick] [--max-words N] [--max-text-bytes N]"
+      << " [--hit-ratio R] [--min-seconds S] [--seed N]"
+      << " [--bigram-words N] [--bigram-text-bytes N]\n";
+    return 1;
+  }
+
+  try
+  {
+    run(settings);
+  }
+  catch (const exception& e)
+  {
+    cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,354 @@
+//Inserts the spaces between the words of each line of a text,
+// using the WordRecognizer with a dictionary, one word per line.
+//
+//Usage: WordSegmenter.exe Dictionary.txt [Input.txt] [--positions] [--threads N]
+//The input is the stdin when no input file is given.
+//Each output line is either the words separated by spaces,
+// or with the "--positions", the "offset,length" pairs separated by spaces.
+//The lines are segmented in parallel, but written in the input order.
+//The throughput summary is written to the stderr.
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Algorithms/ParallelUtilities.h"
+#include "../Algorithms/Regression/DoubleArrayTrie.h"
+#include "../Algorithms/Regression/WordRecognizer.h"
+
+using namespace std;
+using namespace MyCompany::Algorithms;
+using namespace MyCompany::Algorithms::Regression;
+
+namespace
+{
+  using TSize = unsigned int;
+  using TWeight = long long;
+  using TWordRecognizer = WordRecognizer<TSize, TWeight>;
+
+  //The input is read by blocks of this size, which are split into the lines.
+  constexpr size_t block_size = 16 << 20;
+
+  //The lines, given to a thread at once.
+  constexpr size_t lines_per_task = 64;
+
+  struct options final
+  {
+    string dictionary_file;
+    string input_file;
+    bool is_positions = false;
+    size_t thread_count = 0;
+  };
+
+  void print_usage()
+  {
+    cerr << "Usage: WordSegmenter.exe Dictionary.txt [Input.txt] [--positions] [--threads N]\n";
+  }
+
+  void report_error_and_exit(const string& error_message)
+  {
+    cerr << "Error: " << error_message << '\n';
+    print_usage();
+    exit(1);
+  }
+
+  //Only the decimal digits, without a sign or spaces.
+  size_t parse_count(const string& name, const char* value)
+  {
+    char* end = nullptr;
+    errno = 0;
+    const auto result = strtoull(value, &end, 10);
+    if (!isdigit(static_cast<unsigned char>(*value)) || 0 != *end || 0 != errno)
+    {
+      report_error_and_exit("The " + name + " must be a non-negative integer, but got '"
+        + value + "'.");
+    }
+
+    return static_cast<size_t>(result);
+  }
+
+  void parse_options(const int argc, char** argv, options& result)
+  {
+    for (int index = 1; index < argc; ++index)
+    {
+      const string argument = argv[index];
+      if ("--positions" == argument)
+      {
+        result.is_positions = true;
+      }
+      else if ("--threads" == argument)
+      {
+        if (argc <= index + 1)
+        {
+          report_error_and_exit("The --threads must be followed by the thread count.");
+        }
+
+        result.thread_count = parse_count(argument, argv[++index]);
+      }
+      else if (0 == argument.compare(0, 2, "--"))
+      {
+        report_error_and_exit("Unknown option '" + argument + "'.");
+      }
+      else if (result.dictionary_file.empty())
+      {
+        result.dictionary_file = argument;
+      }
+      else if (result.input_file.empty())
+      {
+        result.input_file = argument;
+      }
+      else
+      {
+        report_error_and_exit("Unexpected argument '" + argument + "'.");
+      }
+    }
+
+    if (result.dictionary_file.empty())
+    {
+      report_error_and_exit("The dictionary file is required.");
+    }
+  }
+
+  void trim_carriage_return(string& line)
+  {
+    if (!line.empty() && '\r' == line.back())
+    {
+      line.pop_back();
+    }
+  }
+
+  vector<string> load_dictionary(const string& file_name)
+  {
+    ifstream file(file_name);
+    if (!file)
+    {
+      throw runtime_error("Cannot open the dictionary file '" + file_name + "'.");
+    }
+
+    vector<string> result;
+    string word;
+    while (getline(file, word))
+    {
+      trim_carriage_return(word);
+      if (!word.empty())
+      {
+        result.push_back(word);
+      }
+    }
+
+    if (result.empty())
+    {
+      throw runtime_error("The dictionary file '" + file_name + "' has no words.");
+    }
+
+    return result;
+  }
+
+  //The buffers of a thread, reused for all its lines.
+  struct thread_state final
+  {
+    TWordRecognizer::Workspace workspace;
+    vector<TWordRecognizer::WordPosition> positions;
+    string line;
+  };
+
+  void format_line(const string& line,
+    const vector<TWordRecognizer::WordPosition>& positions,
+    const bool is_positions,
+    string& output)
+  {
+    output.clear();
+    for (size_t index = 0; index < positions.size(); ++index)
+    {
+      if (0 < index)
+      {
+        output += ' ';
+      }
+
+      const auto& position = positions[index];
+      if (is_positions)
+      {
+        output += to_string(position.get_Offset());
+        output += ',';
+        output += to_string(position.get_Length());
+      }
+      else
+      {
+        output.append(line, position.get_Offset(), position.get_Length());
+      }
+    }
+
+    output += '\n';
+  }
+
+  //Segment the "lines" of the "data", and write them in the input order.
+  void segment_lines(const char* data,
+    const vector<pair<size_t, size_t>>& lines,
+    const DoubleArrayTrie<TSize>& trie,
+    const options& settings,
+    ParallelUtilities::ThreadPool& pool,
+    vector<thread_state>& states,
+    vector<string>& outputs,
+    FILE* output_file)
+  {
+    if (outputs.size() < lines.size())
+    {
+      outputs.resize(lines.size());
+    }
+
+    pool.ParallelFor(lines.size(), lines_per_task,
+      [&](const size_t thread_index, const size_t begin, const size_t end)
+    {
+      auto& state = states[thread_index];
+      for (auto index = begin; index < end; ++index)
+      {
+        state.line.assign(data + lines[index].first, lines[index].second);
+        trim_carriage_return(state.line);
+
+        state.positions.clear();
+        if (!state.line.empty())
+        {
+          TWordRecognizer::Recognize(state.line, trie, state.workspace, state.positions);
+        }
+
+        format_line(state.line, state.positions, settings.is_positions, outputs[index]);
+      }
+    });
+
+    for (size_t index = 0; index < lines.size(); ++index)
+    {
+      fwrite(outputs[index].data(), 1, outputs[index].size(), output_file);
+    }
+  }
+
+  struct totals final
+  {
+    size_t lines = 0;
+    size_t bytes = 0;
+  };
+
+  totals segment(FILE* input_file, const DoubleArrayTrie<TSize>& trie, const options& settings)
+  {
+    //The threads are kept for all the blocks.
+    ParallelUtilities::ThreadPool pool(settings.thread_count);
+    vector<thread_state> states(pool.size());
+    vector<string> outputs;
+    vector<pair<size_t, size_t>> lines;
+
+    //A block, starting with the incomplete last line of the previous block.
+    vector<char> buffer(block_size);
+    size_t carried = 0;
+
+    totals result;
+    for (;;)
+    {
+      if (buffer.size() == carried)
+      {//A line is longer than the buffer.
+        buffer.resize(buffer.size() * 2);
+      }
+
+      const auto read = fread(buffer.data() + carried, 1, buffer.size() - carried, input_file);
+      const auto size = carried + read;
+      const auto is_last = 0 == read;
+      result.bytes += read;
+
+      lines.clear();
+      size_t line_begin = 0;
+      for (;;)
+      {
+        const auto found = static_cast<const char*>(
+          memchr(buffer.data() + line_begin, '\n', size - line_begin));
+        if (nullptr == found)
+        {
+          break;
+        }
+
+        const auto line_end = static_cast<size_t>(found - buffer.data());
+        lines.emplace_back(line_begin, line_end - line_begin);
+        line_begin = line_end + 1;
+      }
+
+      if (is_last && line_begin < size)
+      {//The last line without the new line.
+        lines.emplace_back(line_begin, size - line_begin);
+        line_begin = size;
+      }
+
+      segment_lines(buffer.data(), lines, trie, settings, pool, states, outputs, stdout);
+      result.lines += lines.size();
+
+      if (is_last)
+      {
+        break;
+      }
+
+      carried = size - line_begin;
+      memmove(buffer.data(), buffer.data() + line_begin, carried);
+    }
+
+    if (ferror(input_file))
+    {
+      throw runtime_error("Cannot read the input.");
+    }
+
+    return result;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  options settings;
+  parse_options(argc, argv, settings);
+
+  try
+  {
+    const auto started = chrono::steady_clock::now();
+    const DoubleArrayTrie<TSize> trie(load_dictionary(settings.dictionary_file));
+
+    FILE* input_file = stdin;
+    if (!settings.input_file.empty())
+    {
+      input_file = fopen(settings.input_file.c_str(), "rb");
+      if (nullptr == input_file)
+      {
+        throw runtime_error("Cannot open the input file '" + settings.input_file + "'.");
+      }
+    }
+
+    const auto loaded = chrono::steady_clock::now();
+    const auto result = segment(input_file, trie, settings);
+    if (0 != fflush(stdout) || ferror(stdout))
+    {
+      throw runtime_error("Cannot write the output.");
+    }
+
+    if (stdin != input_file)
+    {
+      fclose(input_file);
+    }
+
+    const auto finished = chrono::steady_clock::now();
+    const auto load_seconds = chrono::duration<double>(loaded - started).count();
+    const auto seconds = max(chrono::duration<double>(finished - loaded).count(), 1e-9);
+
+    cerr << "Dictionary: " << trie.size() << " words loaded in " << load_seconds << " s.\n"
+      << "Segmented " << result.lines << " lines, " << result.bytes << " bytes in " << seconds << " s: "
+      << (result.lines / seconds) << " lines/s, "
+      << (result.bytes / seconds / (1 << 20)) << " MB/s.\n";
+  }
+  catch (const exception& e)
+  {
+    cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+
+  return 0;
+}